@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <termios.h>
+
+#include "microconsole_ansi.h"
+#include "microconsole_ansi.c"
+
+// Milliseconds to wait for input before the next frame
+#define FRAME_TIME 16
+
+#define EXIT_ON_E(x) {\
+	int e; \
+	if((e = x) != 0){ \
+		fprintf(stderr, "Error on line %d:\n\t" #x "; -> %d\n", __LINE__, e); \
+		exit(1); \
+	} \
+}
+
+static struct termios original;
+static bool loop = true;
+
+void mc_test_command(struct mc_console *con, int argc, char **argv)
+{
+	int i;
+	for(i = 0; i < argc; i++){
+		mc_printf(con, "%d: %s\n", i, argv[i]);
+	}
+}
+
+void mc_quit_command(struct mc_console *con, int argc, char **argv)
+{
+	loop = false;
+}
+
+static void restore_terminal()
+{
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, &original);
+}
+
+// Every key is read as it's pressed and nothing is echoed or translated
+static int raw_terminal()
+{
+	if(tcgetattr(STDIN_FILENO, &original)){
+		return -1;
+	}
+	atexit(restore_terminal);
+
+	struct termios raw = original;
+	raw.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+	raw.c_oflag &= ~OPOST;
+	raw.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	raw.c_cflag &= ~(CSIZE | PARENB);
+	raw.c_cflag |= CS8;
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+
+	return tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+}
+
+int main(void)
+{
+	if(!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)){
+		fprintf(stderr, "The ANSI demo needs a terminal\n");
+		return 1;
+	}
+	EXIT_ON_E(raw_terminal());
+
+	struct mc_console con;
+	struct mc_ansi term;
+	EXIT_ON_E(mc_ansi_create(&con, &term, STDOUT_FILENO));
+	EXIT_ON_E(mc_map(&con, "test", &mc_test_command));
+	EXIT_ON_E(mc_map(&con, "quit", &mc_quit_command));
+	mc_printf(&con, "Type test to echo the arguments, quit or Ctrl-D to leave\n");
+
+	while(loop){
+		struct pollfd in = {STDIN_FILENO, POLLIN, 0};
+		if(poll(&in, 1, FRAME_TIME) > 0){
+			char bytes[256];
+			ssize_t n = read(STDIN_FILENO, bytes, sizeof(bytes));
+			if(n > 0 && memchr(bytes, 0x04, n)){
+				break;
+			}
+			if(n > 0){
+				EXIT_ON_E(mc_ansi_input(&con, &term, bytes, n));
+			}
+		}
+
+		// There's no signal handler for SIGWINCH, the size is cheap enough to check every frame
+		struct winsize size;
+		if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && (size.ws_col != term.cols || size.ws_row != term.rows)){
+			EXIT_ON_E(mc_ansi_resize(&con, &term, 0, 0));
+		}
+
+		EXIT_ON_E(mc_update(&con));
+		EXIT_ON_E(mc_render(&con));
+		EXIT_ON_E(mc_ansi_render(&con, &term));
+	}
+
+	mc_ansi_free(&term);
+	mc_free(&con);
+
+	return 0;
+}
@@ -0,0 +1,527 @@
+#include "microconsole_ansi.h"
+#define MC_IMPLEMENTATION
+#include "../../micronsole.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+// Longest sequence one cell can take, moving the cursor, changing the attributes and the character
+#define _MC_ANSI_CELL_BYTES 48
+
+static void _mc_ansi_put(struct mc_ansi *term, const char *str, unsigned len)
+{
+	memcpy(term->buf + term->len, str, len);
+	term->len += len;
+}
+
+// Write the whole frame at once, only a terminal that can't keep up needs more than one write
+static int _mc_ansi_flush(struct mc_ansi *term)
+{
+	term->framebytes = term->len;
+	term->totalbytes += term->len;
+
+	unsigned done = 0;
+	while(term->fd >= 0 && done < term->len){
+		ssize_t n = write(term->fd, term->buf + done, term->len - done);
+		if(n < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK){
+				// A non-blocking terminal that is full, wait until it takes more instead of spinning
+				struct pollfd out = {term->fd, POLLOUT, 0};
+				if(poll(&out, 1, -1) >= 0 || errno == EINTR){
+					continue;
+				}
+			}
+			term->len = 0;
+			return -1;
+		}
+		done += n;
+	}
+	term->len = 0;
+
+	return 0;
+}
+
+MC_API int mc_ansi_create(struct mc_console *con, struct mc_ansi *term, int fd)
+{
+	memset(term, 0, sizeof(struct mc_ansi));
+	term->fd = fd;
+	if(mc_create(con)){
+		return -1;
+	}
+	if(mc_ansi_resize(con, term, 0, 0)){
+		mc_ansi_free(term);
+		mc_free(con);
+		return -2;
+	}
+
+	return 0;
+}
+
+MC_API int mc_ansi_free(struct mc_ansi *term)
+{
+	if(term->buf){
+		char seq[32];
+		// Put the cursor under the console so the shell continues after it
+		_mc_ansi_put(term, seq, snprintf(seq, sizeof(seq), "\x1b[0m\x1b[%uH\r\n\x1b[?25h", term->rows));
+		_mc_ansi_flush(term);
+	}
+
+	MC_FREE(term->screen);
+	MC_FREE(term->want);
+	MC_FREE(term->shown);
+	MC_FREE(term->buf);
+	term->screen = NULL;
+	term->want = term->shown = NULL;
+	term->buf = NULL;
+
+	return 0;
+}
+
+MC_API int mc_ansi_resize(struct mc_console *con, struct mc_ansi *term, unsigned cols, unsigned rows)
+{
+	if(cols == 0 || rows == 0){
+		struct winsize size;
+		if(term->fd >= 0 && ioctl(term->fd, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0){
+			cols = size.ws_col;
+			rows = size.ws_row;
+		}else{
+			cols = 80;
+			rows = 24;
+		}
+	}
+
+	struct mc_cell *screen = (struct mc_cell*)MC_REALLOC(term->screen, cols * rows * sizeof(struct mc_cell));
+	if(!screen){
+		return -1;
+	}
+	term->screen = screen;
+
+	uint32_t *want = (uint32_t*)MC_REALLOC(term->want, rows * sizeof(uint32_t));
+	if(!want){
+		return -1;
+	}
+	term->want = want;
+	uint32_t *shown = (uint32_t*)MC_REALLOC(term->shown, rows * sizeof(uint32_t));
+	if(!shown){
+		return -1;
+	}
+	term->shown = shown;
+
+	// A frame never needs more than every cell from scratch, so the buffer doesn't have to grow while it's filled
+	unsigned cap = cols * rows * _MC_ANSI_CELL_BYTES + 64;
+	char *buf = (char*)MC_REALLOC(term->buf, cap);
+	if(!buf){
+		return -1;
+	}
+	term->buf = buf;
+	term->cap = cap;
+
+	term->cols = cols;
+	term->rows = rows;
+
+	// Clear the terminal, the cells that aren't blank are drawn by the next frame
+	unsigned i;
+	for(i = 0; i < cols * rows; i++){
+		term->screen[i] = _MC_BLANK_CELL;
+	}
+	term->len = 0;
+	_mc_ansi_put(term, "\x1b[0m\x1b[?25l\x1b[H\x1b[2J", 17);
+	term->attr = 0;
+	term->fg = MC_DEFAULT_FG;
+	term->bg = MC_DEFAULT_BG;
+	term->curx = term->cury = 0;
+	term->curvalid = true;
+	term->shifted = con->outshifted;
+
+	return mc_set_grid_size(con, cols, rows);
+}
+
+// Keys sent as escape sequences, without the escape
+static const struct {
+	const char *seq;
+	enum mc_keys key;
+} _mc_ansi_keys[] = {
+	{"[A", MC_KEY_UP}, {"[B", MC_KEY_DOWN}, {"[C", MC_KEY_RIGHT}, {"[D", MC_KEY_LEFT},
+	{"OA", MC_KEY_UP}, {"OB", MC_KEY_DOWN}, {"OC", MC_KEY_RIGHT}, {"OD", MC_KEY_LEFT},
+	{"[H", MC_KEY_HOME}, {"[F", MC_KEY_END}, {"OH", MC_KEY_HOME}, {"OF", MC_KEY_END},
+	{"[1~", MC_KEY_HOME}, {"[7~", MC_KEY_HOME}, {"[4~", MC_KEY_END}, {"[8~", MC_KEY_END},
+	{"[2~", MC_KEY_INSERT}, {"[3~", MC_KEY_DELETE}, {"[5~", MC_KEY_PAGE_UP}, {"[6~", MC_KEY_PAGE_DOWN},
+	{"[1;5C", MC_KEY_WORD_RIGHT}, {"[1;5D", MC_KEY_WORD_LEFT}, {"[1;3C", MC_KEY_WORD_RIGHT}, {"[1;3D", MC_KEY_WORD_LEFT},
+	{"f", MC_KEY_WORD_RIGHT}, {"b", MC_KEY_WORD_LEFT}
+};
+
+// Length of the escape sequence at the start of str without the escape, 0 when it isn't complete yet
+static unsigned _mc_ansi_seq_len(const char *str, unsigned len)
+{
+	if(len == 0){
+		return 0;
+	}
+	if(str[0] == 'O'){
+		return len >= 2 ? 2 : 0;
+	}
+	if(str[0] != '['){
+		// Alt and a key
+		return 1;
+	}
+
+	// Parameters and intermediates until the final byte
+	unsigned i;
+	for(i = 1; i < len; i++){
+		if(str[i] >= 0x40 && str[i] <= 0x7e){
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+// Control characters as keys, enter, tab and the unknown ones are typed
+static int _mc_ansi_control(char c)
+{
+	switch(c){
+		case 0x01: return MC_KEY_HOME;
+		case 0x02: return MC_KEY_LEFT;
+		case 0x03: return MC_KEY_CANCEL;
+		case 0x05: return MC_KEY_END;
+		case 0x06: return MC_KEY_RIGHT;
+		case 0x07: return MC_KEY_CANCEL;
+		case 0x08: return MC_KEY_BACKSPACE;
+		case 0x0b: return MC_KEY_KILL_END;
+		case 0x0e: return MC_KEY_DOWN;
+		case 0x10: return MC_KEY_UP;
+		case 0x12: return MC_KEY_SEARCH;
+		case 0x15: return MC_KEY_KILL_START;
+		case 0x17: return MC_KEY_KILL_WORD;
+		case 0x19: return MC_KEY_YANK;
+		case 0x7f: return MC_KEY_BACKSPACE;
+	}
+
+	return -1;
+}
+
+static void _mc_ansi_escape(struct mc_console *con, const char *seq, unsigned len)
+{
+	unsigned i;
+	for(i = 0; i < sizeof(_mc_ansi_keys) / sizeof(_mc_ansi_keys[0]); i++){
+		if(strlen(_mc_ansi_keys[i].seq) == len && memcmp(_mc_ansi_keys[i].seq, seq, len) == 0){
+			mc_input_key(con, _mc_ansi_keys[i].key);
+			return;
+		}
+	}
+}
+
+MC_API int mc_ansi_input(struct mc_console *con, struct mc_ansi *term, const char *bytes, unsigned len)
+{
+	// Finish the sequence that was split first
+	while(term->esclen > 0 && len > 0){
+		term->esc[term->esclen++] = *bytes++;
+		len--;
+		unsigned n = _mc_ansi_seq_len(term->esc, term->esclen);
+		if(n > 0 || term->esclen == sizeof(term->esc)){
+			_mc_ansi_escape(con, term->esc, n);
+			term->esclen = 0;
+		}
+	}
+
+	unsigned i = 0;
+	while(i < len){
+		unsigned start = i;
+		while(i < len && (unsigned char)bytes[i] >= ' ' && bytes[i] != 0x7f){
+			i++;
+		}
+		if(i > start){
+			// Runs of text are typed at once, UTF-8 included
+			mc_input_text(con, bytes + start, i - start);
+			continue;
+		}
+
+		char c = bytes[i++];
+		if(c == 0x1b){
+			if(i == len){
+				// Nothing follows, so it's the escape key itself
+				mc_input_key(con, MC_KEY_CANCEL);
+				break;
+			}
+			unsigned n = _mc_ansi_seq_len(bytes + i, len - i);
+			if(n == 0){
+				n = len - i < sizeof(term->esc) ? len - i : sizeof(term->esc) - 1;
+				memcpy(term->esc, bytes + i, n);
+				term->esclen = n;
+				break;
+			}
+			_mc_ansi_escape(con, bytes + i, n);
+			i += n;
+			continue;
+		}
+
+		int key = _mc_ansi_control(c);
+		if(key >= 0){
+			mc_input_key(con, (enum mc_keys)key);
+		}else{
+			mc_input_char(con, c);
+		}
+	}
+
+	return 0;
+}
+
+static bool _mc_ansi_same(struct mc_cell a, struct mc_cell b)
+{
+	return a.glyph == b.glyph && a.attr == b.attr && a.fg == b.fg && a.bg == b.bg;
+}
+
+// Cells have padding, so rows are compared cell by cell
+static bool _mc_ansi_same_row(const struct mc_cell *a, const struct mc_cell *b, unsigned cols)
+{
+	unsigned x;
+	for(x = 0; x < cols; x++){
+		if(!_mc_ansi_same(a[x], b[x])){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static uint32_t _mc_ansi_row_hash(const struct mc_cell *row, unsigned cols)
+{
+	uint32_t h = 2166136261u;
+	unsigned x;
+	for(x = 0; x < cols; x++){
+		h = (h ^ row[x].glyph ^ ((uint32_t)row[x].attr << 24)) * 16777619u;
+		h = (h ^ row[x].fg ^ ((uint32_t)row[x].bg << 8)) * 16777619u;
+	}
+
+	return h;
+}
+
+// SGR parameter of a palette color, the default is the one of the terminal
+static int _mc_ansi_color(char *seq, unsigned char color, unsigned char def, unsigned base)
+{
+	if(color == def){
+		return sprintf(seq, "%u;", base + 9);
+	}
+	if(color < 8){
+		return sprintf(seq, "%u;", base + color);
+	}
+	if(color < 16){
+		return sprintf(seq, "%u;", base + 60 + color - 8);
+	}
+
+	return sprintf(seq, "%u;5;%u;", base + 8, color);
+}
+
+// Change the attributes and colors that differ with a single sequence
+static void _mc_ansi_sgr(struct mc_ansi *term, unsigned char attr, unsigned char fg, unsigned char bg)
+{
+	if(attr == term->attr && fg == term->fg && bg == term->bg){
+		return;
+	}
+
+	char seq[32];
+	int n = sprintf(seq, "\x1b[");
+	if(attr != term->attr){
+		n += sprintf(seq + n, attr & MC_ATTR_INVERSE ? "7;" : "27;");
+	}
+	if(fg != term->fg){
+		n += _mc_ansi_color(seq + n, fg, MC_DEFAULT_FG, 30);
+	}
+	if(bg != term->bg){
+		n += _mc_ansi_color(seq + n, bg, MC_DEFAULT_BG, 40);
+	}
+	seq[n - 1] = 'm';
+	_mc_ansi_put(term, seq, n);
+
+	term->attr = attr;
+	term->fg = fg;
+	term->bg = bg;
+}
+
+// Rows that line up when what's shown is scrolled up by k
+static unsigned _mc_ansi_matches(const struct mc_console *con, const struct mc_ansi *term, unsigned rows, unsigned k)
+{
+	unsigned cols = term->cols, matches = 0, y;
+	for(y = 0; y + k < rows; y++){
+		matches += term->want[y] == term->shown[y + k] && _mc_ansi_same_row(con->cells + y * cols, term->screen + (y + k) * cols, cols);
+	}
+
+	return matches;
+}
+
+// When the output moved up, have the terminal scroll it instead of drawing all its rows again
+static void _mc_ansi_scroll(struct mc_console *con, struct mc_ansi *term)
+{
+	// Only the distance the console moved its grid by is tried
+	unsigned cols = term->cols, rows = con->outheight - 1, best = con->outshifted - term->shifted;
+	term->shifted = con->outshifted;
+	if(rows < 2 || best == 0 || best >= rows){
+		return;
+	}
+
+	unsigned y;
+	for(y = 0; y < rows; y++){
+		term->want[y] = _mc_ansi_row_hash(con->cells + y * cols, cols);
+		term->shown[y] = _mc_ansi_row_hash(term->screen + y * cols, cols);
+	}
+
+	// It's only worth it when more rows match than without scrolling
+	if(_mc_ansi_matches(con, term, rows, best) <= _mc_ansi_matches(con, term, rows, 0)){
+		return;
+	}
+
+	// New rows are blank in the current attributes
+	char seq[64];
+	_mc_ansi_sgr(term, 0, term->fg, MC_DEFAULT_BG);
+	_mc_ansi_put(term, seq, snprintf(seq, sizeof(seq), "\x1b[1;%ur\x1b[%uS\x1b[r", rows, best));
+	term->curvalid = false;
+
+	memmove(term->screen, term->screen + best * cols, (rows - best) * cols * sizeof(struct mc_cell));
+	unsigned i;
+	for(i = (rows - best) * cols; i < rows * cols; i++){
+		term->screen[i] = _MC_BLANK_CELL;
+	}
+}
+
+// Shortest sequence moving the cursor to x, y without writing, returns its length
+static unsigned _mc_ansi_move(const struct mc_ansi *term, unsigned x, unsigned y, char *seq)
+{
+	int n;
+	if(x == 0){
+		n = y == 0 ? sprintf(seq, "\x1b[H") : sprintf(seq, "\x1b[%uH", y + 1);
+	}else{
+		n = sprintf(seq, "\x1b[%u;%uH", y + 1, x + 1);
+	}
+	if(!term->curvalid){
+		return n;
+	}
+
+	char rel[32];
+	int m = n + 1;
+	if(y == term->cury){
+		if(x == 0){
+			m = sprintf(rel, "\r");
+		}else if(x > term->curx){
+			m = x == term->curx + 1 ? sprintf(rel, "\x1b[C") : sprintf(rel, "\x1b[%uC", x - term->curx);
+		}else if(term->curx - x <= 3){
+			// Backspaces are shorter for short distances
+			m = term->curx - x;
+			memset(rel, '\b', m);
+		}else{
+			m = sprintf(rel, "\x1b[%uD", term->curx - x);
+		}
+	}else if(y == term->cury + 1 && x == 0){
+		m = sprintf(rel, "\r\n");
+	}else if(y > term->cury && x == term->curx){
+		m = y == term->cury + 1 ? sprintf(rel, "\x1b[B") : sprintf(rel, "\x1b[%uB", y - term->cury);
+	}
+	if(m < n){
+		memcpy(seq, rel, m);
+		return m;
+	}
+
+	return n;
+}
+
+static void _mc_ansi_cell(struct mc_ansi *term, struct mc_cell cell)
+{
+	_mc_ansi_sgr(term, cell.attr, cell.fg, cell.bg);
+
+	// Control characters in the output could move the cursor or start escape sequences of their own
+	uint32_t cp = cell.glyph;
+	if(cp < ' ' || cp == 0x7f || (cp >= 0x80 && cp < 0xa0)){
+		cp = '?';
+	}
+	char utf8[4];
+	_mc_ansi_put(term, utf8, _mc_utf8_encode(cp, utf8));
+
+	term->curx++;
+	// Terminals wait with wrapping after the last column and show some characters in two columns
+	if(term->curx == term->cols || cp >= 0x1100){
+		term->curvalid = false;
+	}
+}
+
+// Move the cursor to x, y of the row want
+static void _mc_ansi_goto(struct mc_ansi *term, const struct mc_cell *want, unsigned x, unsigned y)
+{
+	if(term->curvalid && term->curx == x && term->cury == y){
+		return;
+	}
+
+	char seq[32];
+	unsigned n = _mc_ansi_move(term, x, y, seq);
+
+	// Writing the unchanged cells in between again can be shorter than moving over them
+	bool rewrite = term->curvalid && term->cury == y && term->curx < x && x - term->curx < n;
+	unsigned i;
+	for(i = term->curx; rewrite && i < x; i++){
+		rewrite = want[i].glyph >= ' ' && want[i].glyph < 0x7f && want[i].attr == term->attr && want[i].fg == term->fg && want[i].bg == term->bg;
+	}
+	if(rewrite){
+		for(i = term->curx; i < x; i++){
+			_mc_ansi_cell(term, want[i]);
+		}
+		return;
+	}
+
+	_mc_ansi_put(term, seq, n);
+	term->curx = x;
+	term->cury = y;
+	term->curvalid = true;
+}
+
+MC_API int mc_ansi_render(struct mc_console *con, struct mc_ansi *term)
+{
+	if(!con->cells || con->outwidth != term->cols || con->outheight != term->rows){
+		return -1;
+	}
+
+	_mc_ansi_scroll(con, term);
+
+	unsigned cols = term->cols, x, y;
+	for(y = 0; y < term->rows; y++){
+		const struct mc_cell *want = con->cells + y * cols;
+		struct mc_cell *shown = term->screen + y * cols;
+
+		// Where the row is blank until the end
+		unsigned blank = cols;
+		while(blank > 0 && want[blank - 1].glyph == ' ' && want[blank - 1].attr == 0 && want[blank - 1].bg == MC_DEFAULT_BG){
+			blank--;
+		}
+
+		for(x = 0; x < cols; x++){
+			if(_mc_ansi_same(want[x], shown[x])){
+				continue;
+			}
+
+			if(x >= blank){
+				// Erasing the rest of the row is shorter than writing more than a few spaces
+				unsigned changed = 0, i;
+				for(i = x; i < cols; i++){
+					changed += !_mc_ansi_same(want[i], shown[i]);
+				}
+				if(changed > 3){
+					_mc_ansi_goto(term, want, x, y);
+					// The erased cells get the background color
+					_mc_ansi_sgr(term, 0, term->fg, MC_DEFAULT_BG);
+					_mc_ansi_put(term, "\x1b[K", 3);
+					for(i = x; i < cols; i++){
+						shown[i] = want[i];
+					}
+					break;
+				}
+			}
+
+			_mc_ansi_goto(term, want, x, y);
+			_mc_ansi_cell(term, want[x]);
+			shown[x] = want[x];
+		}
+	}
+
+	return _mc_ansi_flush(term);
+}
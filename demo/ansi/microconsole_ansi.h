@@ -0,0 +1,39 @@
+#ifndef MC_ANSI_H
+#define MC_ANSI_H
+
+#include "../../micronsole.h"
+
+// What the terminal shows and where its cursor is, a frame is sent with a single write
+struct mc_ansi {
+	int fd;
+	unsigned cols, rows;
+	struct mc_cell *screen;
+	// Hashes of the rows that should be and that are shown, and the output grid shift of the last frame
+	uint32_t *want, *shown;
+	unsigned shifted;
+	char *buf;
+	unsigned len, cap;
+	// The cursor is lost after writing in the last column or a character that can be double width
+	unsigned curx, cury;
+	bool curvalid;
+	unsigned char attr, fg, bg;
+	// Start of an escape sequence that didn't arrive completely
+	char esc[16];
+	unsigned esclen;
+	// Bytes of the last frame and of all frames
+	unsigned long framebytes, totalbytes;
+};
+
+// Take over the terminal on fd, which should already be in raw mode. The grid gets the size of the terminal.
+MC_API int mc_ansi_create(struct mc_console *con, struct mc_ansi *term, int fd);
+// Show the cursor again and leave the screen as it is
+MC_API int mc_ansi_free(struct mc_ansi *term);
+// Size the grid, 0 takes the size of the terminal. Everything is drawn again in the next frame.
+MC_API int mc_ansi_resize(struct mc_console *con, struct mc_ansi *term, unsigned cols, unsigned rows);
+// Pass the bytes read from the terminal to the console, escape sequences can be split over calls
+MC_API int mc_ansi_input(struct mc_console *con, struct mc_ansi *term, const char *bytes, unsigned len);
+// Send the cells that changed since the previous frame, call it after mc_render.
+// Nothing is written when fd is below 0, which is useful to measure the frames.
+MC_API int mc_ansi_render(struct mc_console *con, struct mc_ansi *term);
+
+#endif
@@ -0,0 +1,838 @@
+#include <stdio.h>
+#include <time.h>
+
+/* The benchmarks are built once per pixel format,
+ * see the Makefile. The ANSI backend brings the
+ * implementation with it. */
+#include "../ansi/microconsole_ansi.h"
+#include "../ansi/microconsole_ansi.c"
+
+#if defined MC_OUTPUT_TEXTURE_RGB
+#define FORMAT "rgb"
+#elif defined MC_OUTPUT_TEXTURE_RGBA
+#define FORMAT "rgba"
+#elif defined MC_OUTPUT_TEXTURE_BGR
+#define FORMAT "bgr"
+#elif defined MC_OUTPUT_TEXTURE_INDEXED8
+#define FORMAT "indexed8"
+#else
+#define FORMAT "bgra"
+#endif
+
+// Every benchmark runs at least this long in seconds
+#define MIN_TIME 0.25
+
+#define EXIT_ON_E(x) {\
+	int e; \
+	if((e = x) != 0){ \
+		fprintf(stderr, "Error on line %d:\n\t" #x "; -> %d\n", __LINE__, e); \
+		exit(1); \
+	} \
+}
+
+static int failed = 0;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// One result per line so the output can be diffed and parsed between releases
+static void report(const char *name, double value, const char *unit)
+{
+	printf("%s,%s,%.6g,%s\n", FORMAT, name, value, unit);
+}
+
+static void check(const char *name, bool ok)
+{
+	printf("%s,%s,%s,check\n", FORMAT, name, ok ? "ok" : "fail");
+	if(!ok){
+		failed = 1;
+	}
+}
+
+// Allocator that counts the calls, to prove the hot paths don't allocate
+static unsigned long allocs = 0;
+
+static void *count_malloc(void *user, size_t size)
+{
+	allocs++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *user, void *ptr, size_t size)
+{
+	allocs++;
+	return realloc(ptr, size);
+}
+
+static void count_free(void *user, void *ptr)
+{
+	free(ptr);
+}
+
+static void bench_blit(const char *name, unsigned cachesize)
+{
+	struct mc_console con;
+	EXIT_ON_E(mc_create(&con));
+	EXIT_ON_E(mc_set_glyph_cache_size(&con, cachesize));
+	EXIT_ON_E(mc_set_texture_size(&con, 1920, 1080));
+
+	unsigned gw = 1920 / con.outwidth, gh = 1080 / con.outheight;
+	unsigned long glyphs = 0;
+	double start = now(), elapsed;
+	do{
+		unsigned x, y;
+		for(y = 0; y + gh <= 1080; y += gh){
+			for(x = 0; x + gw <= 1920; x += gw){
+				mc_blit_glyph_default(&con, x, y, '!' + (x + y + glyphs) % 94);
+			}
+		}
+		glyphs += (1080 / gh) * (1920 / gw);
+		mc_clear_dirty(&con);
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME);
+
+	report(name, glyphs / elapsed, "glyphs/s");
+	mc_free(&con);
+}
+
+// Output that changes every cell of the screen
+static void write_screen(struct mc_console *con, char *line, unsigned frame)
+{
+	unsigned cols = con->outwidth, rows = con->outheight;
+	mc_output_clear(con);
+	unsigned r, c;
+	for(r = 0; r + 1 < rows; r++){
+		for(c = 0; c < cols; c++){
+			line[c] = '!' + (r + c + frame) % 94;
+		}
+		line[cols] = '\n';
+		mc_output_write(con, line, cols + 1);
+	}
+}
+
+static void bench_redraw(const char *name, unsigned width, unsigned height)
+{
+	struct mc_console con;
+	EXIT_ON_E(mc_create(&con));
+	EXIT_ON_E(mc_set_texture_size(&con, width, height));
+
+	unsigned cols = con.outwidth;
+	char *line = (char*)malloc(cols + 1);
+	char result[64];
+
+	// Every cell changes in every frame
+	unsigned frames = 0;
+	double start = now(), elapsed;
+	do{
+		write_screen(&con, line, frames);
+		EXIT_ON_E(mc_render(&con));
+		mc_clear_dirty(&con);
+		frames++;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME || frames < 3);
+	snprintf(result, sizeof(result), "redraw_full_%s", name);
+	report(result, elapsed * 1000.0 / frames, "ms/frame");
+
+	// A new line of output scrolls the screen up
+	frames = 0;
+	start = now();
+	do{
+		unsigned c;
+		for(c = 0; c < cols; c++){
+			line[c] = '!' + (c + frames) % 94;
+		}
+		line[cols] = '\n';
+		mc_output_write(&con, line, cols + 1);
+		EXIT_ON_E(mc_render(&con));
+		mc_clear_dirty(&con);
+		frames++;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME || frames < 3);
+	snprintf(result, sizeof(result), "redraw_scroll_%s", name);
+	report(result, elapsed * 1000.0 / frames, "ms/frame");
+
+	// Only the input line changes
+	frames = 0;
+	start = now();
+	do{
+		mc_input_char(&con, 'a' + frames % 26);
+		if(frames % 64 == 63){
+			mc_input_key(&con, MC_KEY_CANCEL);
+		}
+		EXIT_ON_E(mc_render(&con));
+		mc_clear_dirty(&con);
+		frames++;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME || frames < 3);
+	snprintf(result, sizeof(result), "redraw_keystroke_%s", name);
+	report(result, elapsed * 1000.0 / frames, "ms/frame");
+
+	free(line);
+	mc_free(&con);
+}
+
+// Changing a color of a full screen, indexed textures only need the new palette
+static void bench_palette()
+{
+	struct mc_console con;
+	EXIT_ON_E(mc_create(&con));
+	EXIT_ON_E(mc_set_texture_size(&con, 1920, 1080));
+
+	char *line = (char*)malloc(con.outwidth + 1);
+	write_screen(&con, line, 0);
+	EXIT_ON_E(mc_render(&con));
+	mc_clear_dirty(&con);
+
+	unsigned frames = 0;
+	unsigned long area = 0;
+	double start = now(), elapsed;
+	do{
+		struct mc_color color = {frames & 255, 128, 255 - (frames & 255), 255};
+		EXIT_ON_E(mc_set_palette(&con, MC_DEFAULT_FG, 1, &color));
+		EXIT_ON_E(mc_render(&con));
+		const struct mc_rect *rects;
+		unsigned i, n = mc_get_dirty_rects(&con, &rects);
+		for(i = 0; i < n; i++){
+			area += (unsigned long)rects[i].width * rects[i].height;
+		}
+		mc_clear_dirty(&con);
+		frames++;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME || frames < 3);
+	report("palette_swap_1080p", elapsed * 1000.0 / frames, "ms/frame");
+
+#ifdef MC_OUTPUT_TEXTURE_INDEXED8
+	check("palette_swap_redraws_nothing", area == 0);
+#else
+	check("palette_swap_redraws_all", area >= (unsigned long)frames * 1920 * 1080);
+#endif
+
+	free(line);
+	mc_free(&con);
+}
+
+static void bench_input()
+{
+	struct mc_console con;
+	EXIT_ON_E(mc_create(&con));
+
+	unsigned long keys = 0;
+	double start = now(), elapsed;
+	do{
+		unsigned i;
+		for(i = 0; i < 1000; i++){
+			switch(i % 8){
+				case 5:
+					mc_input_key(&con, MC_KEY_LEFT);
+					break;
+				case 7:
+					mc_input_key(&con, MC_KEY_BACKSPACE);
+					break;
+				default:
+					mc_input_char(&con, 'a' + i % 26);
+					break;
+			}
+			if(i % 100 == 99){
+				mc_input_key(&con, MC_KEY_CANCEL);
+			}
+		}
+		keys += 1000;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME);
+	report("keystrokes", keys / elapsed, "keys/s");
+
+	struct mc_input_event events[100];
+	unsigned i;
+	for(i = 0; i < 100; i++){
+		events[i].key = i % 8 == 5 ? MC_KEY_LEFT : i % 8 == 7 ? MC_KEY_BACKSPACE : MC_KEY_CANCEL;
+		events[i].c = i % 8 == 5 || i % 8 == 7 || i == 99 ? '\0' : 'a' + i % 26;
+	}
+	keys = 0;
+	start = now();
+	do{
+		for(i = 0; i < 10; i++){
+			mc_input_batch(&con, events, 100);
+		}
+		keys += 1000;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME);
+	report("keystrokes_batch", keys / elapsed, "keys/s");
+
+	mc_free(&con);
+}
+
+// A full scrollback of lines that wrap, paged through, jumped around in and reflowed by resizing
+static void bench_scroll()
+{
+	struct mc_console con;
+	EXIT_ON_E(mc_create(&con));
+	EXIT_ON_E(mc_set_grid_size(&con, 240, 67));
+
+	char line[600];
+	unsigned i, n;
+	for(i = 0; i < MC_MAX_OUTPUT_LINES; i++){
+		unsigned len = (i * 7919) % 500;
+		for(n = 0; n < len; n++){
+			line[n] = '!' + (i + n) % 94;
+		}
+		line[len] = '\n';
+		mc_output_write(&con, line, len + 1);
+	}
+	EXIT_ON_E(mc_render(&con));
+
+	unsigned pages = 0, top, total, seeks = 0;
+	double start = now(), elapsed;
+	do{
+		EXIT_ON_E(mc_input_key(&con, MC_KEY_PAGE_UP));
+		EXIT_ON_E(mc_render(&con));
+		EXIT_ON_E(mc_output_position(&con, &top, NULL));
+		if(top == 0){
+			EXIT_ON_E(mc_output_scroll(&con, -(int)MC_MAX_OUTPUT_LINES));
+		}
+		pages++;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME);
+	report("scroll_page", elapsed * 1000.0 / pages, "ms/page");
+
+	bool roundtrip = true;
+	start = now();
+	do{
+		EXIT_ON_E(mc_output_position(&con, NULL, &total));
+		unsigned row = (seeks * 2654435761u) % total;
+		EXIT_ON_E(mc_output_seek(&con, row));
+		EXIT_ON_E(mc_render(&con));
+		EXIT_ON_E(mc_output_position(&con, &top, NULL));
+		if(top != row && row + con.outheight - 1 < total){
+			roundtrip = false;
+		}
+		seeks++;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME);
+	report("scroll_seek", elapsed * 1000.0 / seeks, "ms/seek");
+	check("scroll_seek_roundtrip", roundtrip);
+
+	unsigned resizes = 0;
+	EXIT_ON_E(mc_output_seek(&con, total / 2));
+	start = now();
+	do{
+		EXIT_ON_E(mc_set_grid_size(&con, resizes & 1 ? 240 : 173, 67));
+		EXIT_ON_E(mc_render(&con));
+		resizes++;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME);
+	report("resize_reflow", elapsed * 1000.0 / resizes, "ms/resize");
+
+	mc_free(&con);
+}
+
+static void noop_command(struct mc_console *con, int argc, char **argv)
+{
+}
+
+#define REGISTER_COUNT 100000
+
+static void bench_commands()
+{
+	char (*names)[16] = (char(*)[16])malloc(REGISTER_COUNT * sizeof(*names));
+	unsigned i;
+	for(i = 0; i < REGISTER_COUNT; i++){
+		snprintf(names[i], sizeof(names[i]), "cmd%u", i);
+	}
+
+	struct mc_allocator allocator = {count_malloc, count_realloc, count_free, NULL};
+	struct mc_console con;
+	EXIT_ON_E(mc_create_with_allocator(&con, &allocator));
+
+	double start = now();
+	for(i = 0; i < REGISTER_COUNT; i++){
+		EXIT_ON_E(mc_map(&con, names[i], noop_command));
+	}
+	report("map", REGISTER_COUNT / (now() - start), "commands/s");
+
+	start = now();
+	for(i = 0; i < REGISTER_COUNT; i++){
+		if(!mc_find(&con, names[(i * 7919) % REGISTER_COUNT])){
+			failed = 1;
+		}
+	}
+	report("find", (now() - start) * 1e9 / REGISTER_COUNT, "ns/lookup");
+
+	// The first run sizes the scratch buffer
+	EXIT_ON_E(mc_execute(&con, "cmd42 first \"second arg\" 'third arg'; cmd7 x"));
+	unsigned long before = allocs, commands = 0;
+	double elapsed;
+	start = now();
+	do{
+		for(i = 0; i < 1000; i++){
+			mc_execute(&con, "cmd42 first \"second arg\" 'third arg'; cmd7 x");
+		}
+		commands += 2000;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME);
+	report("dispatch", elapsed * 1e9 / commands, "ns/command");
+	check("dispatch_no_alloc", allocs == before);
+
+	// A command mapped to NULL is gone for completion as well
+	const char *completed[4];
+	int cursor = 0;
+	EXIT_ON_E(mc_map(&con, "reload", noop_command));
+	EXIT_ON_E(mc_map(&con, "reload", NULL));
+	check("unmapped_not_completed", mc_complete(&con, "rel", &cursor, completed, 4) == 0 && !mc_find(&con, "reload"));
+
+	// Console variables are found like the commands and read without a lookup
+	int width = 640;
+	EXIT_ON_E(mc_cvar_int(&con, "r_width", &width, 320, 7680, NULL));
+	before = allocs;
+	commands = 0;
+	bool stored = true;
+	start = now();
+	do{
+		for(i = 0; i < 1000; i++){
+			mc_execute(&con, i % 2 ? "r_width 640" : "r_width 1280");
+			stored = stored && width == (i % 2 ? 640 : 1280);
+		}
+		commands += 1000;
+		elapsed = now() - start;
+	}while(elapsed < MIN_TIME);
+	report("cvar_set", elapsed * 1e9 / commands, "ns/command");
+	check("cvar_set_no_alloc", allocs == before);
+	check("cvar_set_stored", stored);
+
+	mc_free(&con);
+	free(names);
+}
+
+#ifdef MC_MULTITHREADED
+#define PRODUCERS 4
+#define MESSAGES 20000
+
+static struct mc_console logcon;
+
+static int producer(void *arg)
+{
+	int id = (int)(intptr_t)arg;
+	int i;
+	for(i = 0; i < MESSAGES; i++){
+		// Try again when the queue is full so no message is missing
+		while(mc_printf(&logcon, "%d %d\n", id, i)){
+			thrd_yield();
+		}
+	}
+
+	return 0;
+}
+
+// Every producer's messages have to come out complete and in order
+static void bench_log()
+{
+	EXIT_ON_E(mc_create(&logcon));
+
+	thrd_t threads[PRODUCERS];
+	int last[PRODUCERS];
+	int i;
+	for(i = 0; i < PRODUCERS; i++){
+		last[i] = -1;
+	}
+
+	double start = now();
+	for(i = 0; i < PRODUCERS; i++){
+		thrd_create(threads + i, producer, (void*)(intptr_t)i);
+	}
+
+	bool ordered = true;
+	long total = 0;
+	while(total < PRODUCERS * MESSAGES){
+		mc_update(&logcon);
+		unsigned n = mc_output_line_count(&logcon), l;
+		for(l = 0; l + 1 < n; l++){
+			char buf[64];
+			int id, seq;
+			mc_output_get_line(&logcon, l, buf, sizeof(buf));
+			if(sscanf(buf, "%d %d", &id, &seq) != 2 || id < 0 || id >= PRODUCERS || seq != last[id] + 1){
+				ordered = false;
+				total = PRODUCERS * MESSAGES;
+				break;
+			}
+			last[id] = seq;
+			total++;
+		}
+		mc_output_clear(&logcon);
+		thrd_yield();
+	}
+	double elapsed = now() - start;
+
+	for(i = 0; i < PRODUCERS; i++){
+		thrd_join(threads[i], NULL);
+	}
+	report("log_throughput", PRODUCERS * MESSAGES / elapsed, "messages/s");
+	check("log_order", ordered);
+
+	mc_free(&logcon);
+}
+
+// Full redraws at 4k on more and more threads, every result has to match the single threaded pixels
+static void bench_render_threads()
+{
+	struct mc_console con, ref;
+	EXIT_ON_E(mc_create(&con));
+	EXIT_ON_E(mc_create(&ref));
+	EXIT_ON_E(mc_set_texture_size(&con, 3840, 2160));
+	EXIT_ON_E(mc_set_texture_size(&ref, 3840, 2160));
+
+	char *line = (char*)malloc(con.outwidth + 1);
+	char result[64];
+	bool identical = true;
+	unsigned n;
+	for(n = 1; n <= MC_MAX_RENDER_THREADS; n *= 2){
+		EXIT_ON_E(mc_set_render_threads(&con, n));
+
+		unsigned frames = 0;
+		double start = now(), elapsed;
+		do{
+			write_screen(&con, line, frames);
+			EXIT_ON_E(mc_render(&con));
+			mc_clear_dirty(&con);
+			frames++;
+			elapsed = now() - start;
+		}while(elapsed < MIN_TIME || frames < 3);
+		snprintf(result, sizeof(result), "redraw_full_4k_threads_%u", n);
+		report(result, elapsed * 1000.0 / frames, "ms/frame");
+
+		write_screen(&ref, line, frames);
+		EXIT_ON_E(mc_render(&ref));
+		write_screen(&con, line, frames);
+		EXIT_ON_E(mc_render(&con));
+		if(memcmp(con.pixels, ref.pixels, 3840 * 2160 * sizeof(struct mc_pixel)) != 0){
+			identical = false;
+		}
+	}
+	check("render_threads_identical", identical);
+
+	free(line);
+	mc_free(&ref);
+	mc_free(&con);
+}
+#endif
+
+#ifdef MC_ATTACH
+// A pipe that's always full, every frame may only take MC_ATTACH_FRAME_BYTES of it
+static void bench_attach()
+{
+	struct mc_console con;
+	EXIT_ON_E(mc_create(&con));
+
+	int fds[2];
+	if(pipe(fds) || fcntl(fds[1], F_SETFL, O_NONBLOCK) || mc_attach_fd(&con, fds[0]) < 0){
+		fprintf(stderr, "Can't attach a pipe\n");
+		exit(1);
+	}
+
+	// Lines of 64 bytes so every frame ends on a line
+	char chunk[4096];
+	unsigned i;
+	for(i = 0; i < sizeof(chunk); i++){
+		chunk[i] = i % 64 == 63 ? '\n' : '!' + (i / 64) % 94;
+	}
+
+	unsigned long bytes = 0;
+	bool capped = true;
+	double updatetime = 0, worst = 0, start = now();
+	do{
+		while(write(fds[1], chunk, sizeof(chunk)) > 0);
+
+		unsigned head = con.out.head;
+		double t = now();
+		mc_update(&con);
+		t = now() - t;
+		updatetime += t;
+		worst = t > worst ? t : worst;
+
+		bytes += con.out.head - head;
+		if(con.out.head - head > MC_ATTACH_FRAME_BYTES){
+			capped = false;
+		}
+	}while(now() - start < MIN_TIME);
+
+	report("attach_pipe", bytes / updatetime / (1024.0 * 1024.0), "MB/s");
+	report("attach_pipe_worst_frame", worst * 1000.0, "ms");
+	check("attach_frame_cap", capped);
+
+	close(fds[1]);
+	mc_free(&con);
+	close(fds[0]);
+}
+#endif
+
+// Just enough of a terminal to follow what mc_ansi_render sends
+struct vt {
+	unsigned cols, rows, x, y, top, bottom;
+	unsigned char attr, fg, bg;
+	struct mc_cell *cells;
+};
+
+// Erased cells only keep the background color
+static struct mc_cell vt_blank(const struct vt *vt)
+{
+	return (struct mc_cell){' ', 0, vt->fg, vt->bg};
+}
+
+static bool vt_sgr(struct vt *vt, const unsigned *params, unsigned nparams)
+{
+	unsigned i;
+	for(i = 0; i < nparams; i++){
+		unsigned p = params[i];
+		if(p == 0){
+			vt->attr = 0;
+			vt->fg = MC_DEFAULT_FG;
+			vt->bg = MC_DEFAULT_BG;
+		}else if(p == 7 || p == 27){
+			vt->attr = p == 7 ? MC_ATTR_INVERSE : 0;
+		}else if((p >= 30 && p <= 37) || (p >= 90 && p <= 97)){
+			vt->fg = p >= 90 ? p - 90 + 8 : p - 30;
+		}else if((p >= 40 && p <= 47) || (p >= 100 && p <= 107)){
+			vt->bg = p >= 100 ? p - 100 + 8 : p - 40;
+		}else if(p == 39 || p == 49){
+			*(p == 39 ? &vt->fg : &vt->bg) = p == 39 ? MC_DEFAULT_FG : MC_DEFAULT_BG;
+		}else if((p == 38 || p == 48) && i + 2 < nparams && params[i + 1] == 5 && params[i + 2] < 256){
+			*(p == 38 ? &vt->fg : &vt->bg) = params[i + 2];
+			i += 2;
+		}else{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void vt_scroll(struct vt *vt, unsigned n)
+{
+	unsigned cols = vt->cols, rows = vt->bottom - vt->top, i;
+	n = n < rows ? n : rows;
+	memmove(vt->cells + vt->top * cols, vt->cells + (vt->top + n) * cols, (rows - n) * cols * sizeof(struct mc_cell));
+	for(i = (vt->bottom - n) * cols; i < vt->bottom * cols; i++){
+		vt->cells[i] = vt_blank(vt);
+	}
+}
+
+// Returns false on anything mc_ansi_render isn't supposed to send
+static bool vt_feed(struct vt *vt, const char *buf, unsigned len)
+{
+	unsigned i = 0;
+	while(i < len){
+		unsigned char c = buf[i++];
+		if(c == '\r'){
+			vt->x = 0;
+		}else if(c == '\b'){
+			vt->x -= vt->x > 0;
+		}else if(c == '\n'){
+			if(vt->y + 1 == vt->bottom){
+				vt_scroll(vt, 1);
+			}else{
+				vt->y++;
+			}
+		}else if(c == 0x1b){
+			if(i == len || buf[i++] != '['){
+				return false;
+			}
+			unsigned params[8] = {0}, nparams = 0;
+			bool private = i < len && buf[i] == '?';
+			i += private;
+			while(i < len && ((buf[i] >= '0' && buf[i] <= '9') || buf[i] == ';')){
+				if(buf[i] == ';'){
+					if(++nparams == 8){
+						return false;
+					}
+				}else{
+					params[nparams] = params[nparams] * 10 + buf[i] - '0';
+				}
+				i++;
+			}
+			if(i == len){
+				return false;
+			}
+			unsigned n = params[0] ? params[0] : 1;
+			nparams++;
+			switch(buf[i++]){
+				case 'H':
+					vt->y = (params[0] ? params[0] : 1) - 1;
+					vt->x = (params[1] ? params[1] : 1) - 1;
+					break;
+				case 'A': vt->y -= n; break;
+				case 'B': vt->y += n; break;
+				case 'C': vt->x += n; break;
+				case 'D': vt->x -= n; break;
+				case 'J':
+					for(n = 0; n < vt->cols * vt->rows; n++){
+						vt->cells[n] = vt_blank(vt);
+					}
+					break;
+				case 'K':
+					for(n = vt->x; n < vt->cols; n++){
+						vt->cells[n + vt->y * vt->cols] = vt_blank(vt);
+					}
+					break;
+				case 'S':
+					vt_scroll(vt, n);
+					break;
+				case 'r':
+					vt->top = params[0] ? params[0] - 1 : 0;
+					vt->bottom = params[1] ? params[1] : vt->rows;
+					vt->x = vt->y = 0;
+					break;
+				case 'm':
+					if(!vt_sgr(vt, params, nparams)){
+						return false;
+					}
+					break;
+				case 'l':
+				case 'h':
+					if(!private){
+						return false;
+					}
+					break;
+				default:
+					return false;
+			}
+			if(vt->x >= vt->cols || vt->y >= vt->rows){
+				return false;
+			}
+		}else{
+			unsigned extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+			uint32_t cp = extra ? c & (0x3f >> extra) : c;
+			while(extra-- > 0 && i < len){
+				cp = (cp << 6) | (buf[i++] & 0x3f);
+			}
+			// The cursor stays on the last column, mc_ansi_render moves it before writing more
+			vt->cells[vt->x + vt->y * vt->cols] = (struct mc_cell){cp, vt->attr, vt->fg, vt->bg};
+			if(vt->x + 1 < vt->cols){
+				vt->x++;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Bytes sent to the terminal for the edits that happen the most, with a terminal checking the result
+static void bench_ansi()
+{
+	struct mc_console con;
+	struct mc_ansi term;
+	EXIT_ON_E(mc_ansi_create(&con, &term, -1));
+	EXIT_ON_E(mc_ansi_resize(&con, &term, 80, 25));
+
+	struct vt vt = {80, 25, 0, 0, 0, 25, 0, MC_DEFAULT_FG, MC_DEFAULT_BG, NULL};
+	vt.cells = (struct mc_cell*)malloc(80 * 25 * sizeof(struct mc_cell));
+	if(!vt.cells){
+		exit(1);
+	}
+
+	unsigned i;
+	for(i = 0; i < 40; i++){
+		mc_printf(&con, "line %u of the output, long enough to cover most of the row\n", i);
+	}
+
+	// Everything that's not blank after a resize, every frame is checked by following it in our own terminal
+	EXIT_ON_E(mc_update(&con));
+	EXIT_ON_E(mc_render(&con));
+	EXIT_ON_E(mc_ansi_render(&con, &term));
+	bool ok = vt_feed(&vt, term.buf, term.framebytes);
+	unsigned long redraw = term.framebytes, type = 0, print = 0;
+	report("ansi_redraw", redraw, "bytes/frame");
+
+	// Half of the typed characters are deleted, the cursor moves over the other half
+	const char *names[] = {"ansi_type", "ansi_backspace", "ansi_cursor_left", "ansi_history", "ansi_print_line"};
+	unsigned edit;
+	for(edit = 0; edit < 5; edit++){
+		unsigned long bytes = 0, frames = edit == 1 || edit == 2 ? 5 : 10;
+		for(i = 0; i < frames; i++){
+			switch(edit){
+				case 0:
+					mc_input_char(&con, 'a' + i);
+					break;
+				case 1:
+					mc_input_key(&con, MC_KEY_BACKSPACE);
+					break;
+				case 2:
+					mc_input_key(&con, MC_KEY_LEFT);
+					break;
+				case 3:
+					mc_input_key(&con, MC_KEY_CANCEL);
+					mc_input_text(&con, i % 2 ? "echo odd\r" : "echo even and longer\r", i % 2 ? 9 : 21);
+					mc_input_key(&con, MC_KEY_UP);
+					break;
+				case 4:
+					mc_printf(&con, "one more line of output %u\n", i);
+					break;
+			}
+			EXIT_ON_E(mc_update(&con));
+			EXIT_ON_E(mc_render(&con));
+			EXIT_ON_E(mc_ansi_render(&con, &term));
+			ok = ok && vt_feed(&vt, term.buf, term.framebytes);
+			bytes += term.framebytes;
+		}
+		report(names[edit], (double)bytes / frames, "bytes/frame");
+		if(edit == 0){
+			type = bytes / frames;
+		}else if(edit == 4){
+			print = bytes / frames;
+		}
+	}
+
+	// Colored output, which isn't measured
+	mc_printf(&con, "\x1b[31mred\x1b[0m, \x1b[1;44mbold on blue\x1b[0m and \x1b[38;5;200mpink\x1b[0m\n");
+	mc_printf(&con, "\x1b[41m%80s\x1b[0m\n", "a red row");
+	EXIT_ON_E(mc_update(&con));
+	EXIT_ON_E(mc_render(&con));
+	EXIT_ON_E(mc_ansi_render(&con, &term));
+	ok = ok && vt_feed(&vt, term.buf, term.framebytes);
+
+	// The foreground of a blank cell can't be seen
+	for(i = 0; ok && i < 80 * 25; i++){
+		struct mc_cell a = vt.cells[i], b = con.cells[i];
+		ok = a.glyph == b.glyph && a.attr == b.attr && a.bg == b.bg && (a.fg == b.fg || (a.glyph == ' ' && a.attr == 0));
+	}
+	check("ansi_screen_matches", ok);
+	check("ansi_type_small", type <= 16);
+	check("ansi_print_line_scrolls", print * 4 < redraw);
+
+	free(vt.cells);
+	mc_ansi_free(&term);
+	mc_free(&con);
+}
+
+int main(void)
+{
+	printf("format,benchmark,value,unit\n");
+
+	check("blit_self_check", mc_blit_self_check() == 0);
+
+	bench_blit("blit_cached", MC_GLYPH_CACHE_SIZE);
+	bench_blit("blit_uncached", 0);
+
+	bench_redraw("720p", 1280, 720);
+	bench_redraw("1080p", 1920, 1080);
+	bench_redraw("4k", 3840, 2160);
+	bench_palette();
+
+	bench_input();
+	bench_commands();
+	bench_scroll();
+	bench_ansi();
+
+#ifdef MC_MULTITHREADED
+	bench_log();
+	bench_render_threads();
+#endif
+
+#ifdef MC_ATTACH
+	bench_attach();
+#endif
+
+	return failed;
+}
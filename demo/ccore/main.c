@@ -27,7 +27,10 @@
 
 void mc_test_command(struct mc_console *con, int argc, char **argv)
 {
-	printf("Command\n");
+	int i;
+	for(i = 0; i < argc; i++){
+		mc_printf(con, "%d: %s\n", i, argv[i]);
+	}
 }
 
 int main(void)
@@ -49,6 +52,7 @@ int main(void)
 	EXIT_ON_E(mc_ccore_setup_texture(&con, gltex));
 	EXIT_ON_E(mc_map(&con, "test", &mc_test_command));
 
+	struct mc_ccore_events events = {.n = 0};
 	bool loop = true;
 	while(loop){
 		while(ccWindowEventPoll()){
@@ -56,14 +60,15 @@ int main(void)
 			if(event.type == CC_EVENT_WINDOW_QUIT || (event.type == CC_EVENT_KEY_DOWN && event.keyCode == CC_KEY_ESCAPE)){
 				loop = false;
 			}else{
-				EXIT_ON_E(mc_ccore_handle_event(&con, event));
+				EXIT_ON_E(mc_ccore_queue_event(&con, &events, event));
 			}
 		}
+		EXIT_ON_E(mc_ccore_flush_events(&con, &events));
 		
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		EXIT_ON_E(mc_blit_glyph_default(&con, 5, 5, 'a'));
-		EXIT_ON_E(mc_blit_glyph_default(&con, 20, 5, 'b'));
+		EXIT_ON_E(mc_update(&con));
+		EXIT_ON_E(mc_render(&con));
 		EXIT_ON_E(mc_ccore_render_texture(&con, gltex));
 		
 		glBindTexture(GL_TEXTURE_2D, gltex);
@@ -19,34 +19,101 @@ MC_API int mc_ccore_create(struct mc_console *con)
 	return 0;
 }
 
-MC_API int mc_ccore_handle_event(struct mc_console *con, ccEvent event)
+// The key events don't say which modifiers are held, so the control keys are followed
+static bool _mc_ccore_control = false;
+
+static bool _mc_ccore_translate_event(ccEvent event, struct mc_input_event *input)
 {
-	switch(event.type){
-		case CC_EVENT_KEY_DOWN:
-			switch(event.keyCode){
-				case CC_KEY_LEFT:
-					mc_input_key(con, MC_KEY_LEFT);
-					break;
-				case CC_KEY_RIGHT:
-					mc_input_key(con, MC_KEY_RIGHT);
-					break;
-				case CC_KEY_UP:
-					mc_input_key(con, MC_KEY_UP);
-					break;
-				case CC_KEY_DOWN:
-					mc_input_key(con, MC_KEY_DOWN);
-					break;
-				case CC_KEY_BACKSPACE:
-					mc_input_key(con, MC_KEY_BACKSPACE);
-					break;
-				default:
-					mc_input_char(con, event.keyCode);
-					break;
+	if((event.type == CC_EVENT_KEY_DOWN || event.type == CC_EVENT_KEY_UP) &&
+			(event.keyCode == CC_KEY_LCONTROL || event.keyCode == CC_KEY_RCONTROL)){
+		_mc_ccore_control = event.type == CC_EVENT_KEY_DOWN;
+		return false;
+	}
+	if(event.type != CC_EVENT_KEY_DOWN){
+		return false;
+	}
+
+	input->c = '\0';
+	switch(event.keyCode){
+		case CC_KEY_LEFT:
+			input->key = MC_KEY_LEFT;
+			break;
+		case CC_KEY_RIGHT:
+			input->key = MC_KEY_RIGHT;
+			break;
+		case CC_KEY_UP:
+			input->key = MC_KEY_UP;
+			break;
+		case CC_KEY_DOWN:
+			input->key = MC_KEY_DOWN;
+			break;
+		case CC_KEY_BACKSPACE:
+			input->key = MC_KEY_BACKSPACE;
+			break;
+		case CC_KEY_DELETE:
+			input->key = MC_KEY_DELETE;
+			break;
+		case CC_KEY_HOME:
+			input->key = MC_KEY_HOME;
+			break;
+		case CC_KEY_END:
+			input->key = MC_KEY_END;
+			break;
+		case CC_KEY_INSERT:
+			input->key = MC_KEY_INSERT;
+			break;
+		case CC_KEY_PAGEUP:
+			input->key = MC_KEY_PAGE_UP;
+			break;
+		case CC_KEY_PAGEDOWN:
+			input->key = MC_KEY_PAGE_DOWN;
+			break;
+		default:
+			if(_mc_ccore_control && (event.keyCode == 'r' || event.keyCode == 'R')){
+				input->key = MC_KEY_SEARCH;
+				break;
+			}
+			input->c = event.keyCode;
+			if(input->c == '\0'){
+				return false;
 			}
 			break;
-		default: break;
 	}
 
+	return true;
+}
+
+MC_API int mc_ccore_handle_event(struct mc_console *con, ccEvent event)
+{
+	struct mc_input_event input;
+	if(_mc_ccore_translate_event(event, &input)){
+		mc_input_batch(con, &input, 1);
+	}
+
+	return 0;
+}
+
+MC_API int mc_ccore_queue_event(struct mc_console *con, struct mc_ccore_events *events, ccEvent event)
+{
+	struct mc_input_event input;
+	if(!_mc_ccore_translate_event(event, &input)){
+		return 0;
+	}
+
+	if(events->n == MC_CCORE_MAX_EVENTS){
+		mc_ccore_flush_events(con, events);
+	}
+	events->events[events->n++] = input;
+
+	return 0;
+}
+
+MC_API int mc_ccore_flush_events(struct mc_console *con, struct mc_ccore_events *events)
+{
+	// Errors like a full input line are not fatal, the characters are just dropped
+	mc_input_batch(con, events->events, events->n);
+	events->n = 0;
+
 	return 0;
 }
 
@@ -63,9 +130,49 @@ MC_API int mc_ccore_setup_texture(struct mc_console *con, GLuint tex)
 	return 0;
 }
 
+#ifdef MC_OUTPUT_TEXTURE_INDEXED8
+// The pixel maps turn the indices into colors while uploading
+static void _mc_ccore_load_palette(struct mc_console *con)
+{
+	const struct mc_color *palette = mc_get_palette(con);
+	GLfloat maps[4][256];
+	unsigned i;
+	for(i = 0; i < 256; i++){
+		maps[0][i] = palette[i].r / 255.0f;
+		maps[1][i] = palette[i].g / 255.0f;
+		maps[2][i] = palette[i].b / 255.0f;
+		maps[3][i] = palette[i].a / 255.0f;
+	}
+
+	glPixelMapfv(GL_PIXEL_MAP_I_TO_R, 256, maps[0]);
+	glPixelMapfv(GL_PIXEL_MAP_I_TO_G, 256, maps[1]);
+	glPixelMapfv(GL_PIXEL_MAP_I_TO_B, 256, maps[2]);
+	glPixelMapfv(GL_PIXEL_MAP_I_TO_A, 256, maps[3]);
+}
+#endif
+
 MC_API int mc_ccore_render_texture(struct mc_console *con, GLuint tex)
 {
+	const struct mc_rect *rects;
+	unsigned nrects = mc_get_dirty_rects(con, &rects);
+
+	// Damage covering everything is also what happens after a resize, so the texture is (re)allocated
+	bool full = nrects == 1 && rects[0].width == con->width && rects[0].height == con->height;
+#ifdef MC_OUTPUT_TEXTURE_INDEXED8
+	// The colors are applied when uploading, so a new palette is a new texture
+	if(mc_palette_dirty(con)){
+		_mc_ccore_load_palette(con);
+		full = true;
+	}
+#endif
+	if(nrects == 0 && !full){
+		return 0;
+	}
+
 	glBindTexture(GL_TEXTURE_2D, tex);
+#ifdef MC_OUTPUT_TEXTURE_INDEXED8
+	glPixelTransferi(GL_MAP_COLOR, GL_TRUE);
+#endif
 
 #ifdef MC_OUTPUT_TEXTURE_RGB
 	GLint format = GL_RGB;
@@ -75,11 +182,46 @@ MC_API int mc_ccore_render_texture(struct mc_console *con, GLuint tex)
 	GLint format = GL_BGR;
 #elif defined MC_OUTPUT_TEXTURE_BGRA
 	GLint format = GL_BGRA;
+#elif defined MC_OUTPUT_TEXTURE_INDEXED8
+	GLint format = GL_COLOR_INDEX;
+#endif
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if(full){
+#ifdef MC_OUTPUT_TEXTURE_INDEXED8
+		// Palette entries can be transparent
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, con->width, con->height, 0, format, GL_UNSIGNED_BYTE, con->pixels);
+#else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, con->width, con->height, 0, format, GL_UNSIGNED_BYTE, con->pixels);
+#endif
+#ifdef MC_STATS
+		mc_stats_add_upload(con, (unsigned long)con->width * con->height * sizeof(struct mc_pixel));
+#endif
+	}else{
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, con->width);
+		unsigned i;
+		for(i = 0; i < nrects; i++){
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS, rects[i].x);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS, rects[i].y);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, rects[i].x, rects[i].y, rects[i].width, rects[i].height, format, GL_UNSIGNED_BYTE, con->pixels);
+#ifdef MC_STATS
+			mc_stats_add_upload(con, (unsigned long)rects[i].width * rects[i].height * sizeof(struct mc_pixel));
 #endif
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+	}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, con->width, con->height, 0, format, GL_UNSIGNED_BYTE, con->pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+#ifdef MC_OUTPUT_TEXTURE_INDEXED8
+	glPixelTransferi(GL_MAP_COLOR, GL_FALSE);
+#endif
 	glBindTexture(GL_TEXTURE_2D, 0);
 
+	mc_clear_dirty(con);
+
 	return 0;
 }
 #endif // MC_CCORE_OPENGL
@@ -16,8 +16,21 @@
 
 #include "../../micronsole.h"
 
+#ifndef MC_CCORE_MAX_EVENTS
+#define MC_CCORE_MAX_EVENTS 256
+#endif
+
+// Input of a frame that's handed to the console in one go
+struct mc_ccore_events {
+	struct mc_input_event events[MC_CCORE_MAX_EVENTS];
+	unsigned n;
+};
+
 MC_API int mc_ccore_create(struct mc_console *con);
 MC_API int mc_ccore_handle_event(struct mc_console *con, ccEvent event);
+// Collect the events of a frame and pass them to the console with mc_ccore_flush_events
+MC_API int mc_ccore_queue_event(struct mc_console *con, struct mc_ccore_events *events, ccEvent event);
+MC_API int mc_ccore_flush_events(struct mc_console *con, struct mc_ccore_events *events);
 
 #ifdef MC_CCORE_OPENGL
 MC_API int mc_ccore_setup_texture(struct mc_console *con, GLuint tex);
@@ -6,15 +6,51 @@
 DEFINES:
 MC_PRIVATE - make all the functions static, so they can only be used on the file where MC_IMPLEMENTATION is defined
 MC_OUTPUT_TEXTURE_[RGB, RGBA, BGR, BGRA] - render the output as a texture with the defined pixel format
+MC_OUTPUT_TEXTURE_INDEXED8 - render the output as a texture of 8 bit indices in the 256 color palette, see mc_set_palette
 MC_DYNAMIC_ARRAYS - dynamically grow the array size instead of using static sizes
 MC_MAX_COMMANDS (n>0) - maximum number of commands that can be registered, only useable when MC_DYNAMIC_ARRAYS is not defined
 MC_MAX_COMMAND_LENGTH (n>0) - maximum string length of the command, only useable when MC_DYNAMIC_ARRAYS is not defined
+MC_MAX_COMMAND_STORAGE (n>0) - total bytes for all command names including terminators, only useable when MC_DYNAMIC_ARRAYS is not defined
+MC_MAX_CVARS (n>0) - maximum number of console variables, they count as commands as well, only useable when MC_DYNAMIC_ARRAYS is not defined
 MC_MAX_INPUT_LENGTH (n>0) - maximum length of the input string, only useable when MC_DYNAMIC_ARRAYS is not defined
+MC_MAX_ARGS (n>0) - maximum number of arguments of a command, including the name
+MC_EXEC_BUFFER_SIZE (n>0) - bytes for the command lines being run, commands calling mc_execute share it, only useable when MC_DYNAMIC_ARRAYS is not defined
+MC_OUTPUT_SIZE (n>0, power of two) - size in bytes of the scrollback, the oldest lines are dropped when it's full
+MC_MAX_OUTPUT_LINES (n>0, power of two) - maximum number of lines in the scrollback
+MC_HISTORY_SIZE (n>0, power of two) - size in bytes of the command history, the oldest commands are dropped when it's full
+MC_MAX_HISTORY (n>1, power of two) - maximum number of commands in the history
+MC_MULTITHREADED - mc_print, mc_write and mc_printf can be called from any thread without locking, requires C11 atomics
+MC_LOG_QUEUE_SIZE (n>0, power of two) - number of messages that can wait for mc_update, more are dropped, only useable when MC_MULTITHREADED is defined
+MC_LOG_RECORD_SIZE (n>0) - maximum length of a single printed message, longer messages are cut off
+MC_WORKERS (n>0) - number of threads running the commands registered with mc_map_async, only useable when MC_MULTITHREADED is defined
+MC_MAX_JOBS (n>0) - maximum number of async commands that are waiting or running at once
+MC_JOB_ARGS_SIZE (n>0) - bytes for the arguments of an async command including their terminators
+MC_MAX_RENDER_THREADS (n>0) - maximum number of threads mc_render can rasterize with, see mc_set_render_threads, only useable when MC_MULTITHREADED is defined
+MC_ATTACH - follow pipes and growing files into the scrollback with mc_attach_fd and mc_attach_file, requires POSIX
+MC_MAX_ATTACHED (n>0) - maximum number of pipes and files that can be attached at once, only useable when MC_ATTACH is defined
+MC_ATTACH_FRAME_BYTES (n>0) - maximum number of bytes mc_update reads from all the attached pipes and files together, only useable when MC_ATTACH is defined
+MC_ATTACH_WINDOW (n>0, multiple of the page size) - bytes of an attached file that are mapped in memory at once, only useable when MC_ATTACH is defined
+MC_ATTACH_LINE_SIZE (n>0) - unfinished lines up to this length are held back until they end, only useable when MC_ATTACH is defined
+MC_MAX_COLOR_SPANS (n>0, power of two) - maximum number of color changes in the scrollback, the colors of the oldest text are dropped first
+MC_DEFAULT_FG, MC_DEFAULT_BG (0-255) - palette colors of the text and the background without escape sequences
+MC_MAX_DIRTY_RECTS (n>0) - maximum number of damaged texture rectangles that are tracked before they are merged
+MC_GLYPH_CACHE_SIZE (n>=0) - default size in bytes of the pre-rendered glyph cache, can be changed with mc_set_glyph_cache_size
 MC_ASSERT - define the assert function, leave empty for no assertions
+MC_PROMPT (string) - text in front of the input line
+MC_STATS - count what the console does every frame, see mc_get_stats and the "stats" command
+MC_STATS_TIME() - function returning a time in seconds as a double for timing the commands, only useable when MC_STATS is defined
+MC_NO_SIMD - always use the scalar glyph blitter, otherwise SSE2 or AVX2 is used when the compiler targets it
+MC_MALLOC, MC_REALLOC, MC_FREE - replace the memory functions, define all three, mc_create_with_allocator sets them per console instead
 
-TODO:
-UTF8 support
-Option to replace stdlib
+UTF-8:
+The input and output are UTF-8, every codepoint takes one cell of the grid. Invalid bytes are shown as U+FFFD
+and characters the font doesn't have as '?', accented latin and typographic characters fall back to ASCII.
+
+COLORS:
+Cells have a foreground and background color from a palette of 256, which starts as the xterm palette with
+entry 0 transparent. The output is colored with the SGR escape sequences of terminals: 30-37, 40-47, 90-97 and
+100-107, 38;5;n and 48;5;n, 38;2;r;g;b and 48;2;r;g;b matched to the palette, 39, 49 and 0 for the defaults.
+Other escape sequences are dropped.
 
 LICENSE:
 This software is dual-licensed to the public domain and under the following
@@ -26,17 +62,39 @@ publish and distribute this file as you see fit.
 #define MC_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
 #include <assert.h>
 
+#ifdef MC_MULTITHREADED
+#include <stdatomic.h>
+#include <threads.h>
+#endif
+
+#ifdef MC_STATS
+#include <time.h>
+#endif
+
+#ifdef MC_ATTACH
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
 #ifdef MC_PRIVATE
 #define MC_API static
 #else
 #define MC_API extern
 #endif
 
-#if defined MC_OUTPUT_TEXTURE_RGB || defined MC_OUTPUT_TEXTURE_RGBA || defined MC_OUTPUT_TEXTURE_BGR || defined MC_OUTPUT_TEXTURE_BGRA
+#if defined MC_OUTPUT_TEXTURE_RGB || defined MC_OUTPUT_TEXTURE_RGBA || defined MC_OUTPUT_TEXTURE_BGR || defined MC_OUTPUT_TEXTURE_BGRA || \
+	defined MC_OUTPUT_TEXTURE_INDEXED8
 #define MC_OUTPUT_TEXTURE
 #endif
 
@@ -44,19 +102,151 @@ publish and distribute this file as you see fit.
 #define MC_MAX_COMMANDS 128
 #endif
 
+#ifndef MC_OUTPUT_SIZE
+#define MC_OUTPUT_SIZE (64 * 1024)
+#endif
+
+#ifndef MC_MAX_OUTPUT_LINES
+#define MC_MAX_OUTPUT_LINES 4096
+#endif
+
+#ifndef MC_HISTORY_SIZE
+#define MC_HISTORY_SIZE (64 * 1024)
+#endif
+
+#ifndef MC_MAX_HISTORY
+#define MC_MAX_HISTORY 1024
+#endif
+
+#ifndef MC_LOG_QUEUE_SIZE
+#define MC_LOG_QUEUE_SIZE 1024
+#endif
+
+#ifndef MC_LOG_RECORD_SIZE
+#define MC_LOG_RECORD_SIZE 256
+#endif
+
+#ifndef MC_WORKERS
+#define MC_WORKERS 2
+#endif
+
+#ifndef MC_MAX_JOBS
+#define MC_MAX_JOBS 32
+#endif
+
+#ifndef MC_MAX_CVARS
+#define MC_MAX_CVARS 64
+#endif
+
 #ifndef MC_MAX_INPUT_LENGTH
 #define MC_MAX_INPUT_LENGTH 256
 #endif
 
+#ifndef MC_MAX_ARGS
+#define MC_MAX_ARGS 32
+#endif
+
+#ifndef MC_EXEC_BUFFER_SIZE
+#define MC_EXEC_BUFFER_SIZE (4 * MC_MAX_INPUT_LENGTH)
+#endif
+
+#ifndef MC_JOB_ARGS_SIZE
+#define MC_JOB_ARGS_SIZE MC_MAX_INPUT_LENGTH
+#endif
+
+#ifndef MC_MAX_RENDER_THREADS
+#define MC_MAX_RENDER_THREADS 8
+#endif
+
+#ifndef MC_MAX_ATTACHED
+#define MC_MAX_ATTACHED 4
+#endif
+
+#ifndef MC_ATTACH_FRAME_BYTES
+#define MC_ATTACH_FRAME_BYTES (64 * 1024)
+#endif
+
+#ifndef MC_ATTACH_WINDOW
+#define MC_ATTACH_WINDOW (1024 * 1024)
+#endif
+
+#ifndef MC_ATTACH_LINE_SIZE
+#define MC_ATTACH_LINE_SIZE 1024
+#endif
+
+#ifndef MC_MAX_COLOR_SPANS
+#define MC_MAX_COLOR_SPANS 1024
+#endif
+
+#ifndef MC_DEFAULT_FG
+#define MC_DEFAULT_FG 15
+#endif
+
+#ifndef MC_DEFAULT_BG
+#define MC_DEFAULT_BG 0
+#endif
+
 #ifndef MC_MAX_COMMAND_LENGTH
 #define MC_MAX_COMMAND_LENGTH 64
 #endif
 
+#ifndef MC_MAX_COMMAND_STORAGE
+#define MC_MAX_COMMAND_STORAGE (MC_MAX_COMMANDS * MC_MAX_COMMAND_LENGTH)
+#endif
+
+// Hash table size for the static command table, the smallest power of two that's at least twice MC_MAX_COMMANDS
+#define _MC_POW2_1(x) ((x) | ((x) >> 1))
+#define _MC_POW2_2(x) (_MC_POW2_1(x) | (_MC_POW2_1(x) >> 2))
+#define _MC_POW2_4(x) (_MC_POW2_2(x) | (_MC_POW2_2(x) >> 4))
+#define _MC_POW2_8(x) (_MC_POW2_4(x) | (_MC_POW2_4(x) >> 8))
+#define _MC_POW2_16(x) (_MC_POW2_8(x) | (_MC_POW2_8(x) >> 16))
+#define _MC_COMMAND_SLOTS (_MC_POW2_16(2 * MC_MAX_COMMANDS - 1) + 1)
+// Every command adds at most a leaf and a split node to the completion tree
+#define _MC_TRIE_NODES (2 * MC_MAX_COMMANDS + 1)
+
+#ifndef MC_MAX_DIRTY_RECTS
+#define MC_MAX_DIRTY_RECTS 16
+#endif
+
+#ifndef MC_GLYPH_CACHE_SIZE
+#define MC_GLYPH_CACHE_SIZE (256 * 1024)
+#endif
+
 #ifndef MC_ASSERT
 #define MC_ASSERT(x) assert(x)
 #endif
 
-enum mc_keys {MC_KEY_LEFT, MC_KEY_RIGHT, MC_KEY_UP, MC_KEY_DOWN, MC_KEY_BACKSPACE};
+#if defined MC_MALLOC || defined MC_REALLOC || defined MC_FREE
+#if !defined MC_MALLOC || !defined MC_REALLOC || !defined MC_FREE
+#error "MC_MALLOC, MC_REALLOC and MC_FREE have to be defined together"
+#endif
+#else
+#define MC_MALLOC(size) malloc(size)
+#define MC_REALLOC(ptr, size) realloc(ptr, size)
+#define MC_FREE(ptr) free(ptr)
+#endif
+
+#ifndef MC_PROMPT
+#define MC_PROMPT "> "
+#endif
+
+enum mc_keys {
+	MC_KEY_LEFT, MC_KEY_RIGHT, MC_KEY_UP, MC_KEY_DOWN, MC_KEY_BACKSPACE,
+	MC_KEY_DELETE, MC_KEY_HOME, MC_KEY_END, MC_KEY_INSERT,
+	MC_KEY_WORD_LEFT, MC_KEY_WORD_RIGHT,
+	// Cut from the cursor to the end, the word before the cursor or from the start to the cursor, yank pastes it back
+	MC_KEY_KILL_END, MC_KEY_KILL_WORD, MC_KEY_KILL_START, MC_KEY_YANK,
+	// Search the history backwards for the typed text, pressing it again finds the next older match
+	MC_KEY_SEARCH,
+	// Stop the search, otherwise cancel the running async commands or clear the line when there are none
+	MC_KEY_CANCEL,
+	// Scroll the output a screen back or forward
+	MC_KEY_PAGE_UP, MC_KEY_PAGE_DOWN
+};
+
+enum mc_cvar_type {
+	MC_CVAR_INT, MC_CVAR_FLOAT, MC_CVAR_BOOL, MC_CVAR_STRING, MC_CVAR_ENUM
+};
 
 #ifdef MC_OUTPUT_TEXTURE
 struct mc_pixel {
@@ -68,518 +258,5957 @@ struct mc_pixel {
 	unsigned char b, g, r;
 #elif defined MC_OUTPUT_TEXTURE_BGRA
 	unsigned char b, g, r, a;
+#elif defined MC_OUTPUT_TEXTURE_INDEXED8
+	unsigned char index;
+#endif
+};
+
+// Palette entry, the alpha is only used by the RGBA and BGRA textures and by backends of indexed textures
+struct mc_color {
+	unsigned char r, g, b, a;
+};
+
+struct mc_rect {
+	unsigned x, y, width, height;
+};
+
+// Bitmap font, consoles share it by reference
+struct mc_font {
+	// Fonts from mc_font_load are freed when the last reference is released, built-in fonts have a count of -1 and are never freed
+#ifdef MC_MULTITHREADED
+	atomic_int refs;
+#else
+	int refs;
 #endif
+	unsigned glyphwidth, glyphheight, nglyphs;
+	// One bitmask per glyph row, bit n is the nth pixel from the left
+	const uint32_t *rows;
+	// Glyph of every codepoint below npagemap * 256 in two levels, the page of the 256 codepoints and the glyph in the page,
+	// -1 when there is none. Page 0 is empty and shared by all the codepoints without glyphs.
+	const uint16_t *pagemap;
+	const int16_t *pages;
+	unsigned npagemap;
+	// Glyph shown for the codepoints the font doesn't have
+	int replacement;
 };
 #endif // MC_OUTPUT_TEXTURE
 
+#define MC_ATTR_INVERSE 1
+
+struct mc_cell {
+	// Unicode codepoint
+	uint32_t glyph;
+	unsigned char attr;
+	// Palette colors
+	unsigned char fg, bg;
+};
+
+// Colors of the output from pos on until the next span
+struct _mc_span {
+	unsigned pos;
+	unsigned char fg, bg;
+};
+
+// Colors set by the escape sequences of an output stream and the start of a sequence that didn't end yet
+struct _mc_sgr {
+	unsigned char fg, bg;
+	char esc[32];
+	unsigned esclen;
+};
+
+// Characters of an output line and the rows they wrap to, line is the line that last used the slot
+struct _mc_wrap {
+	unsigned line, len, chars, rows;
+};
+
+struct mc_trie_node {
+	// The edge label is an offset in the command names, depth is the length of the whole path
+	unsigned label, labellen, depth;
+	// Children are sorted, cmd is the command ending here and any is one of the commands below
+	int parent, child, sibling;
+	int cmd, any;
+};
+
+// Text split in lines in a power of two sized buffer, old lines are dropped when it's full.
+// Positions and line numbers keep increasing and wrap around, only their differences matter.
+struct mc_ring {
+	char *data;
+	unsigned *lines;
+	unsigned size, maxlines;
+	// Write position, the oldest line and one past the newest line
+	unsigned head, first, end;
+};
+
+#ifdef MC_STATS
+struct mc_stat_counters {
+	unsigned long glyphs, pixels, uploadbytes, dirtyarea, commands;
+	// Seconds spent in commands, async commands count when they complete
+	double commandtime;
+};
+
+struct mc_stats {
+	// Number of mc_update calls
+	unsigned long frames;
+	// The previous frame, the frame in progress and everything since mc_create
+	struct mc_stat_counters last, current, total;
+	unsigned scrollbackbytes, scrollbacklines;
+};
+#endif
+
+// A key press, or a typed character when c isn't 0
+struct mc_input_event {
+	enum mc_keys key;
+	// Unicode codepoint
+	uint32_t c;
+};
+
+// Match of the reverse history search for one length of the query
+struct mc_search_step {
+	unsigned line, offset;
+	char c;
+	bool found;
+};
+
+#ifdef MC_MULTITHREADED
+struct mc_log_record {
+	atomic_uint seq;
+	unsigned len;
+	char text[MC_LOG_RECORD_SIZE + 1];
+};
+#endif
+
+// Memory functions called with user as the first argument, realloc with a NULL pointer has to allocate
+struct mc_allocator {
+	void *(*malloc)(void *user, size_t size);
+	void *(*realloc)(void *user, void *ptr, size_t size);
+	void (*free)(void *user, void *ptr);
+	void *user;
+};
+
 typedef struct mc_console _mc_console_t;
 typedef void (*mc_cmd_ptr) (_mc_console_t *term, int argc, char **argv);
+// Called after a console variable got a different value
+typedef void (*mc_cvar_ptr) (_mc_console_t *term, const char *name);
+
+#ifdef MC_MULTITHREADED
+struct mc_job;
+// Runs on a worker thread, print with mc_job_print and return early when mc_job_cancelled is true
+typedef int (*mc_async_cmd_ptr) (struct mc_job *job, int argc, char **argv);
+// Called from mc_update with what the command returned, -1 when it was cancelled before it started
+typedef void (*mc_job_done_ptr) (_mc_console_t *term, int result);
+
+struct mc_job {
+	_mc_console_t *con;
+	mc_async_cmd_ptr func;
+	mc_job_done_ptr done;
+	atomic_bool cancelled;
+	int result;
+#ifdef MC_STATS
+	// Command that's run and how long it took
+	unsigned cmd;
+	double time;
+#endif
+	// Next job in the list the job is in
+	int next;
+	int argc;
+	char *argv[MC_MAX_ARGS + 1];
+	char args[MC_JOB_ARGS_SIZE];
+};
+
+#ifdef MC_OUTPUT_TEXTURE
+struct _mc_glyph_cache;
+
+// Thread rasterizing the rows range packs, the first row in the high and the end in the low 32 bits
+struct _mc_render_thread {
+	_mc_console_t *con;
+	thrd_t thread;
+	atomic_ullong range;
+	// Every thread but the first has its own glyph cache so they don't share any writes, the first uses the one of the console
+	struct _mc_glyph_cache *glyphcache;
+};
+
+// What changed in a row of cells when it was rasterized
+struct _mc_band {
+	unsigned x0, x1, cells, glyphs;
+};
+#endif
+#endif
+
+#ifdef MC_ATTACH
+// Pipe or file followed into the scrollback, the slot is free when fd is -1
+struct _mc_attached {
+	int fd;
+	bool file, ownsfd;
+	// Files are read from offset through the window mapped at mapoffset, skipline drops the line offset is in
+	off_t offset, mapoffset;
+	char *map;
+	bool skipline;
+	// Start of a line read from a pipe that didn't end yet, with its colors
+	char partial[MC_ATTACH_LINE_SIZE];
+	unsigned partiallen;
+	struct _mc_span partialspans[8];
+	unsigned npartialspans;
+	struct _mc_sgr sgr;
+};
+#endif
+
+struct mc_command {
+	// Offset of the null terminated name in cmdnames
+	unsigned name, namelen;
+	uint32_t hash;
+	mc_cmd_ptr func;
+	// Console variable that the command shows and sets, -1 for the others
+	int cvar;
+#ifdef MC_MULTITHREADED
+	mc_async_cmd_ptr async;
+	mc_job_done_ptr done;
+#endif
+#ifdef MC_STATS
+	unsigned long calls;
+	double time;
+#endif
+};
+
+// The variable is owned by the caller, the console only writes values that are valid
+struct _mc_cvar {
+	enum mc_cvar_type type;
+	void *value;
+	unsigned cmd;
+	// Range of numbers, size of strings including the terminator and the names of enums
+	double min, max;
+	unsigned size;
+	const char *const *names;
+	mc_cvar_ptr changed;
+};
 
 struct mc_console {
-	char *outstr;
-	unsigned outlen, outmaxlen;
+#ifdef MC_STATS
+	struct mc_stats stats;
+#endif
+
+	// Where the memory of the console comes from, with an arena everything is taken from one block
+	struct mc_allocator allocator;
+	void *arenablock;
+	char *arena, *arenalast;
+	size_t arenasize, arenaused;
+
+	// Scrollback, a fixed size ring of text with the start of every line
+	struct mc_ring out;
+#ifndef MC_DYNAMIC_ARRAYS
+	char outbuf[MC_OUTPUT_SIZE];
+	unsigned outlinebuf[MC_MAX_OUTPUT_LINES];
+#endif
 	unsigned outwidth, outheight;
 	bool outupdate;
 
+	// Colors of the scrollback, text before the first span has the default colors
+#ifdef MC_DYNAMIC_ARRAYS
+	struct _mc_span *spans;
+#else
+	struct _mc_span spans[MC_MAX_COLOR_SPANS];
+#endif
+	unsigned spanfirst, spanend;
+	struct _mc_sgr outsgr;
+
+#ifdef MC_ATTACH
+	// Sources read by mc_update, the first one read takes turns every frame
+	struct _mc_attached attached[MC_MAX_ATTACHED];
+	unsigned attachnext;
+#endif
+
+#ifdef MC_MULTITHREADED
+	// Messages printed from any thread waiting to be moved to the scrollback by mc_update
+	struct mc_log_record *logqueue;
+	atomic_uint logenqueue, logdequeue;
+	atomic_uint logdropped, loghighwater;
+	unsigned logconsumed;
+
+	// Async commands, the job slots are in a free list owned by the console thread
+	// and in the queued and finished lists protected by jobmutex
+	struct mc_job *jobs;
+	thrd_t workers[MC_WORKERS];
+	unsigned nworkers, njobs;
+	mtx_t jobmutex;
+	cnd_t jobcond;
+	int jobfree, jobqueue, jobqueuetail, jobfinished;
+	bool jobquit;
+#endif
+
+	// Character grid of outwidth by outheight, cells is what should be shown and prevcells what is shown
+	struct mc_cell *cells, *prevcells;
+	// Set when the output or input text changed and the grid has to be laid out again
+	bool outdirty, indirty;
+	// Output line shown on the last output row, how many rows it had and the first row with output of the previous mc_render
+	unsigned outlaidline, outlaidrows, outlaidtop;
+	// Rows the output grid moved up in total, a backend can scroll what it shows by the difference between frames
+	unsigned outshifted;
+
+	// Lines wrap at the grid width. The rows of a line are counted when it's shown and summed in a Fenwick tree over the line
+	// slots of the scrollback, so any row can be found in O(log n) without counting all the lines. Lines that weren't shown
+	// yet count as one row.
+#ifdef MC_DYNAMIC_ARRAYS
+	struct _mc_wrap *outwrap;
+	unsigned *outtree;
+#else
+	struct _mc_wrap outwrap[MC_MAX_OUTPUT_LINES];
+	unsigned outtree[MC_MAX_OUTPUT_LINES];
+#endif
+	// Lines from here on were added after the index was last updated
+	unsigned outindexend;
+	// Unless the view follows the end of the output its top is row outtoprow of outtopline
+	bool outscrolled;
+	unsigned outtopline, outtoprow;
+
+	// Input line as a gap buffer with the text in instr[0, ingap) and instr[ingapend, incap), the gap follows the cursor inpos lazily
 #ifdef MC_DYNAMIC_ARRAYS
-	char *instr;
+	char *instr, *killbuf;
+	unsigned killcap;
 #else
 	char instr[MC_MAX_INPUT_LENGTH];
+	char killbuf[MC_MAX_INPUT_LENGTH];
 #endif
-	unsigned inpos;
+	unsigned inpos, ingap, ingapend, incap, killlen;
+	// Start of a UTF-8 character that was typed in parts
+	char inpend[4];
+	unsigned inpendlen;
 
+	// Typed characters are inserted at the cursor, otherwise they overwrite the character under it
 	bool insert;
 
+	// Entered commands, the last line holds the edited line while browsing, histpos is the line that's shown
+	struct mc_ring hist;
+#ifndef MC_DYNAMIC_ARRAYS
+	char histbuf[MC_HISTORY_SIZE];
+	unsigned histlinebuf[MC_MAX_HISTORY];
+#endif
+	unsigned histpos;
+
+	// Reverse search, search[n] is the match for the first n characters of the query
+#ifdef MC_DYNAMIC_ARRAYS
+	struct mc_search_step *search;
+	unsigned searchcap;
+#else
+	struct mc_search_step search[MC_MAX_INPUT_LENGTH];
+#endif
+	unsigned searchlen;
+	bool searching;
+
+	// Copies of the command lines that are being run, split into arguments in place.
+	// A command calling mc_execute gets the space after exectop.
 #ifdef MC_DYNAMIC_ARRAYS
-	mc_cmd_ptr *cmdfuncs;
-	char **cmds;
+	char *execbuf;
+	unsigned execcap;
 #else
-	mc_cmd_ptr cmdfuncs[MC_MAX_COMMANDS];
-	char cmds[MC_MAX_COMMANDS][MC_MAX_COMMAND_LENGTH];
+	char execbuf[MC_EXEC_BUFFER_SIZE];
 #endif
-	unsigned ncmds;
+	unsigned exectop;
+
+	// Commands with their names packed in cmdnames, found through the open addressing table cmdslots
+#ifdef MC_DYNAMIC_ARRAYS
+	struct mc_command *cmds;
+	char *cmdnames;
+	unsigned *cmdslots;
+	unsigned cmdcap, cmdnamescap, ncmdslots;
+#else
+	struct mc_command cmds[MC_MAX_COMMANDS];
+	char cmdnames[MC_MAX_COMMAND_STORAGE];
+	unsigned cmdslots[_MC_COMMAND_SLOTS];
+#endif
+	unsigned ncmds, cmdnameslen;
+#ifdef MC_DYNAMIC_ARRAYS
+	struct _mc_cvar *cvars;
+	unsigned cvarcap;
+#else
+	struct _mc_cvar cvars[MC_MAX_CVARS];
+#endif
+	unsigned ncvars;
+
+	// Radix tree over the command names for completion, node 0 is the root
+#ifdef MC_DYNAMIC_ARRAYS
+	struct mc_trie_node *trie;
+	unsigned triecap;
+#else
+	struct mc_trie_node trie[_MC_TRIE_NODES];
+#endif
+	unsigned ntrie;
+	// Completion candidate that is shown and the node all candidates are below, 0 when not completing
+	int compcur, comproot;
 
 #ifdef MC_OUTPUT_TEXTURE
 	unsigned width, height;
 	struct mc_pixel *pixels;
+
+	// The palette changed since the last mc_clear_dirty, the other textures have it expanded to pixels
+	struct mc_color palette[256];
+	bool palettedirty;
+#ifndef MC_OUTPUT_TEXTURE_INDEXED8
+	struct mc_pixel palettepixels[256];
+#endif
+
+	struct mc_font *font;
+	struct _mc_glyph_cache *glyphcache;
+	unsigned glyphcachesize;
+
+	// Regions of the texture that changed since the last mc_clear_dirty
+	struct mc_rect dirty[MC_MAX_DIRTY_RECTS];
+	unsigned ndirty;
+
+#ifdef MC_MULTITHREADED
+	// Threads rasterizing bands of one row of cells in mc_render, the first is the thread calling mc_render
+	struct _mc_render_thread renderthreads[MC_MAX_RENDER_THREADS];
+	unsigned nrenderthreads, renderbusy, rendergen;
+	mtx_t rendermutex;
+	cnd_t renderstart, renderdone;
+	bool renderquit;
+	struct _mc_band *bands;
+#endif
 #endif
 };
 
 MC_API int mc_create(struct mc_console *con);
+// Use allocator for all the memory of the console, NULL uses MC_MALLOC, MC_REALLOC and MC_FREE
+MC_API int mc_create_with_allocator(struct mc_console *con, const struct mc_allocator *allocator);
+// Take all the memory of the console from one block of size bytes, which is allocated when memory is NULL.
+// Freed memory is only reused when it's the newest block, mc_free releases the whole block at once.
+MC_API int mc_create_with_arena(struct mc_console *con, const struct mc_allocator *allocator, void *memory, size_t size);
 MC_API int mc_free(struct mc_console *con);
 
+// Register a command, mapping an existing name again replaces its function. A NULL function makes it unknown again.
 MC_API int mc_map(struct mc_console *con, const char *cmd, mc_cmd_ptr func);
+// Returns the function of the command or NULL when it's not registered
+MC_API mc_cmd_ptr mc_find(struct mc_console *con, const char *cmd);
+// Run a line of commands separated by ';', arguments are split on spaces and can be quoted with " or ' and escaped with \.
+// Returns -2 when a command isn't registered, -3 when a console variable refused the value, -4 when an async command
+// couldn't be queued and -1 when the line doesn't fit.
+MC_API int mc_execute(struct mc_console *con, const char *line);
+#ifdef MC_MULTITHREADED
+// Register a command that runs on a worker thread, done is called when it returned and can be NULL
+MC_API int mc_map_async(struct mc_console *con, const char *cmd, mc_async_cmd_ptr func, mc_job_done_ptr done);
+// Ask the async commands to stop, the ones that didn't start yet are skipped
+MC_API int mc_cancel_jobs(struct mc_console *con);
+// Number of async commands that didn't finish yet
+MC_API unsigned mc_pending_jobs(struct mc_console *con);
+// Output of an async command, nothing is printed anymore after it's cancelled
+MC_API int mc_job_print(struct mc_job *job, const char *str);
+MC_API int mc_job_printf(struct mc_job *job, const char *fmt, ...);
+MC_API bool mc_job_cancelled(struct mc_job *job);
+#endif
+// Register a console variable bound to value, which the caller owns and can read at any time without a lookup.
+// Typing the name shows the value and the name followed by a value sets it, values out of range or not in names are
+// refused. The size of a string includes the terminator and names has n entries. Registering a name again rebinds it.
+MC_API int mc_cvar_int(struct mc_console *con, const char *name, int *value, int min, int max, mc_cvar_ptr changed);
+MC_API int mc_cvar_float(struct mc_console *con, const char *name, float *value, float min, float max, mc_cvar_ptr changed);
+MC_API int mc_cvar_bool(struct mc_console *con, const char *name, bool *value, mc_cvar_ptr changed);
+MC_API int mc_cvar_string(struct mc_console *con, const char *name, char *value, unsigned size, mc_cvar_ptr changed);
+MC_API int mc_cvar_enum(struct mc_console *con, const char *name, int *value, const char *const *names, unsigned n, mc_cvar_ptr changed);
+// Set a console variable from text like typing it does, returns -2 when it's not a variable and -3 when the value is refused
+MC_API int mc_cvar_set(struct mc_console *con, const char *name, const char *value);
+// Write the value as text to buf, returns its length or -2 when it's not a variable
+MC_API int mc_cvar_get(struct mc_console *con, const char *name, char *buf, unsigned buflen);
+// Get the names of the commands starting with prefix in sorted order, max at a time.
+// Set cursor to 0 for the first page, it's -1 after the last page. Returns the number of names.
+MC_API int mc_complete(struct mc_console *con, const char *prefix, int *cursor, const char **names, int max);
 
 MC_API int mc_input_key(struct mc_console *con, enum mc_keys key);
+// Type a byte, the bytes of a UTF-8 character can be typed one by one
 MC_API int mc_input_char(struct mc_console *con, char key);
+MC_API int mc_input_codepoint(struct mc_console *con, uint32_t codepoint);
+// Apply a frame of events at once, runs of characters are inserted together
+MC_API int mc_input_batch(struct mc_console *con, const struct mc_input_event *events, unsigned n);
+// Type text as if it was entered on the keyboard, for pasting and replaying input
+MC_API int mc_input_text(struct mc_console *con, const char *str, unsigned len);
+// Returns the null terminated input line, it's valid until the next input call
+MC_API const char *mc_input_get(struct mc_console *con);
+MC_API unsigned mc_input_length(struct mc_console *con);
+
+// Add a line to the history, empty lines and repeats of the last line are skipped
+MC_API int mc_history_add(struct mc_console *con, const char *line);
+MC_API unsigned mc_history_count(struct mc_console *con);
+// Copy command n, where 0 is the oldest command, into buf and return the length of the command
+MC_API int mc_history_get_line(struct mc_console *con, unsigned n, char *buf, unsigned buflen);
+
+// Print to the console, with MC_MULTITHREADED these can be called from any thread and show up after the next mc_update
+MC_API int mc_write(struct mc_console *con, const char *str, unsigned len);
+MC_API int mc_print(struct mc_console *con, const char *str);
+MC_API int mc_printf(struct mc_console *con, const char *fmt, ...);
+// Call once per frame from the thread that owns the console
+MC_API int mc_update(struct mc_console *con);
+// Number of messages dropped because the queue was full and the most messages that were waiting at once
+MC_API int mc_get_log_stats(struct mc_console *con, unsigned *dropped, unsigned *highwater);
+
+#ifdef MC_ATTACH
+// Follow a pipe or socket, mc_update reads the complete lines into the scrollback without blocking. The descriptor is made
+// non-blocking and stays owned by the caller, it's detached at the end of the stream. Returns the source or a negative code.
+MC_API int mc_attach_fd(struct mc_console *con, int fd);
+// Follow a file as it grows, only a window of it is mapped in memory at a time so any size can be followed.
+// With fromend only what's written after attaching is shown, otherwise the last scrollback full of the file as well.
+MC_API int mc_attach_file(struct mc_console *con, const char *path, bool fromend);
+// Stop following the source, a last line that didn't end is shown as it is
+MC_API int mc_detach(struct mc_console *con, int source);
+#endif
+
+#ifdef MC_STATS
+MC_API int mc_get_stats(struct mc_console *con, struct mc_stats *stats);
+// Called by the backend with the number of bytes it uploaded from the texture
+MC_API int mc_stats_add_upload(struct mc_console *con, unsigned long bytes);
+#endif
+
+// Append text to the scrollback, only from the thread that owns the console
+MC_API int mc_output_write(struct mc_console *con, const char *str, unsigned len);
+MC_API int mc_output_clear(struct mc_console *con);
+MC_API unsigned mc_output_line_count(struct mc_console *con);
+// Copy line n, where 0 is the oldest line, into buf and return the length of the line
+MC_API int mc_output_get_line(struct mc_console *con, unsigned n, char *buf, unsigned buflen);
+
+// Size the character grid, with texture output this is done by mc_set_texture_size
+MC_API int mc_set_grid_size(struct mc_console *con, unsigned cols, unsigned rows);
+// Lay out the text on the grid and draw the cells that changed since the previous call
+MC_API int mc_render(struct mc_console *con);
+// Scroll the output back by rows, negative rows scroll forward. The view follows new output again once it reaches the end.
+MC_API int mc_output_scroll(struct mc_console *con, int rows);
+// Show the output from a row on, counting the wrapped rows from the oldest line
+MC_API int mc_output_seek(struct mc_console *con, unsigned row);
+// Row at the top of the view and the number of wrapped rows, for scroll bars. Lines that weren't shown yet count as one row.
+MC_API int mc_output_position(struct mc_console *con, unsigned *top, unsigned *total);
 
 #ifdef MC_OUTPUT_TEXTURE
+// Load a font in the ccFont format, it starts with one reference
+MC_API struct mc_font *mc_font_load(const void *data, size_t size);
+// The font consoles start with, it's built in and doesn't need loading or releasing
+MC_API struct mc_font *mc_font_default();
+MC_API int mc_font_retain(struct mc_font *font);
+MC_API int mc_font_release(struct mc_font *font);
+// The console keeps a reference to the font, the grid size follows its glyph size
+MC_API int mc_set_font(struct mc_console *con, struct mc_font *font);
+
 MC_API int mc_set_texture_size(struct mc_console *con, unsigned width, unsigned height);
 
-MC_API int mc_blit_glyph_default(struct mc_console *con, unsigned x, unsigned y, char glyph);
+// Mark a region of the texture as changed, overlapping and adjacent regions are merged
+MC_API int mc_damage(struct mc_console *con, unsigned x, unsigned y, unsigned width, unsigned height);
+MC_API unsigned mc_get_dirty_rects(struct mc_console *con, const struct mc_rect **rects);
+// Call after the dirty regions are uploaded
+MC_API int mc_clear_dirty(struct mc_console *con);
+
+MC_API int mc_fill_rect(struct mc_console *con, unsigned x, unsigned y, unsigned width, unsigned height, struct mc_pixel color);
+// Fill the texture with the default background
+MC_API int mc_clear(struct mc_console *con);
+
+// Change n palette entries from first on. Indexed textures only need the new palette, the others are drawn again.
+MC_API int mc_set_palette(struct mc_console *con, unsigned first, unsigned n, const struct mc_color *colors);
+// The 256 palette entries
+MC_API const struct mc_color *mc_get_palette(struct mc_console *con);
+// Returns true when the palette changed since the last mc_clear_dirty
+MC_API bool mc_palette_dirty(struct mc_console *con);
+
+// Set the memory budget in bytes of the pre-rendered glyph cache, 0 disables it. Render threads each get an equal share of it.
+MC_API int mc_set_glyph_cache_size(struct mc_console *con, unsigned bytes);
+
+MC_API int mc_blit_glyph(struct mc_console *con, unsigned x, unsigned y, uint32_t codepoint, struct mc_pixel fg, struct mc_pixel bg);
+MC_API int mc_blit_glyph_default(struct mc_console *con, unsigned x, unsigned y, uint32_t codepoint);
+// Compare the vectorized glyph blitter against the scalar one, returns 0 when they are identical
+MC_API int mc_blit_self_check();
+
+#ifdef MC_MULTITHREADED
+// Rasterize the changed rows in mc_render on n threads including the calling one, 1 renders on the calling thread only
+MC_API int mc_set_render_threads(struct mc_console *con, unsigned n);
+#endif
 #endif
 
 #endif // MC_H
 
 #ifdef MC_IMPLEMENTATION
 
-MC_API int mc_create(struct mc_console *con)
-{
-	MC_ASSERT(con);
-	memset(con, 0, sizeof(struct mc_console));
+#define _MC_NO_LINE ((unsigned)~0u)
 
-#ifdef MC_DYNAMIC_ARRAYS
-	con->instr = (char*)calloc(1, sizeof(char));
-	con->outstr = (char*)calloc(1, sizeof(char));
-#else
-	memset(con->instr, '\0', MC_MAX_INPUT_LENGTH * sizeof(char));
-	memset(con->cmdfuncs, 0, MC_MAX_COMMANDS * sizeof(mc_cmd_ptr));
-	for(int i = 0; i <  MC_MAX_COMMANDS; i++){
-		memset(con->cmds[i], '\0', MC_MAX_COMMAND_LENGTH * sizeof(char));
-	}
-#endif
+// Cell of an empty grid and the cell that's never shown, which makes every cell be drawn
+#define _MC_BLANK_CELL ((struct mc_cell){' ', 0, MC_DEFAULT_FG, MC_DEFAULT_BG})
+#define _MC_NO_CELL ((struct mc_cell){'\0', 0, 0, 0})
 
-	return 0;
+static bool _mc_cell_equal(struct mc_cell a, struct mc_cell b)
+{
+	return a.glyph == b.glyph && a.attr == b.attr && a.fg == b.fg && a.bg == b.bg;
 }
 
-MC_API int mc_free(struct mc_console *con)
+#ifdef MC_STATS
+#define _MC_STAT(con, counter, n) ((con)->stats.current.counter += (n))
+
+#ifndef MC_STATS_TIME
+#if defined __STDC_VERSION__ && __STDC_VERSION__ >= 201112L
+static double _mc_stats_time()
 {
-	MC_ASSERT(con);
+	struct timespec t;
+	timespec_get(&t, TIME_UTC);
 
-	free(con->outstr);
-#ifdef MC_DYNAMIC_ARRAYS
-	free(con->instr);
-	free(con->cmdfuncs);
-	free(con->cmds);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+#define MC_STATS_TIME() _mc_stats_time()
+#else
+#define MC_STATS_TIME() ((double)clock() / CLOCKS_PER_SEC)
 #endif
-#ifdef MC_OUTPUT_TEXTURE
-	free(con->pixels);
+#endif
+#else
+#define _MC_STAT(con, counter, n)
 #endif
 
-	return 0;
+static void _mc_ring_init(struct mc_ring *ring, char *data, unsigned size, unsigned *lines, unsigned maxlines)
+{
+	ring->data = data;
+	ring->lines = lines;
+	ring->size = size;
+	ring->maxlines = maxlines;
+	ring->head = 0;
+	ring->first = 0;
+	ring->end = 1;
+	ring->lines[0] = 0;
 }
 
-MC_API int mc_map(struct mc_console *con, const char *cmd, mc_cmd_ptr func)
+static unsigned _mc_ring_line_start(const struct mc_ring *ring, unsigned line)
 {
-	MC_ASSERT(con);
-#ifdef MC_DYNAMIC_ARRAYS
-	con->cmdfuncs = (mc_cmd_ptr*)realloc(con->cmdfuncs, con->ncmds * sizeof(mc_cmd_ptr));
-	con->cmds = (char**)realloc(con->cmds, con->ncmds * sizeof(char*));
-#else
-	MC_ASSERT(con->ncmds < MC_MAX_COMMANDS);
-	if(con->ncmds == MC_MAX_COMMANDS){
-		return -1;
+	return ring->lines[line & (ring->maxlines - 1)];
+}
+
+// Length of a line without the newline
+static unsigned _mc_ring_line_len(const struct mc_ring *ring, unsigned line)
+{
+	if(line + 1 == ring->end){
+		return ring->head - _mc_ring_line_start(ring, line);
 	}
-#endif
 
-	con->cmdfuncs[con->ncmds] = func;
-#ifdef MC_DYNAMIC_ARRAYS
-	con->cmds[con->ncmds] = (char*)malloc(strlen(cmd));
-#endif
-	strcpy(con->cmds[con->ncmds], cmd);
+	return _mc_ring_line_start(ring, line + 1) - 1 - _mc_ring_line_start(ring, line);
+}
 
-	con->ncmds++;
+static char _mc_ring_char(const struct mc_ring *ring, unsigned pos)
+{
+	return ring->data[pos & (ring->size - 1)];
+}
 
-	return 0;
+static void _mc_ring_copy(const struct mc_ring *ring, unsigned pos, char *dst, unsigned len)
+{
+	unsigned offset = pos & (ring->size - 1);
+	unsigned n = len < ring->size - offset ? len : ring->size - offset;
+	memcpy(dst, ring->data + offset, n);
+	memcpy(dst + n, ring->data, len - n);
 }
 
-MC_API int mc_input_key(struct mc_console *con, enum mc_keys key)
+static void _mc_ring_new_line(struct mc_ring *ring)
 {
-	MC_ASSERT(con);
-	switch(key){
-		case MC_KEY_LEFT:
-			if(con->inpos > 0){
-				con->inpos--;
-			}
-			break;
-		case MC_KEY_RIGHT:
-			if(con->instr[con->inpos] != '\0'){
-				con->inpos++;
-			}
-			break;
-		case MC_KEY_UP:
-			break;
-		case MC_KEY_DOWN:
-			break;
-		case MC_KEY_BACKSPACE:
-			if(con->inpos > 0){
-				con->inpos--;
-				memmove(con->instr + con->inpos, con->instr + con->inpos + 1, strlen(con->instr) - con->inpos);
-			}
-			break;
+	if(ring->end - ring->first == ring->maxlines){
+		ring->first++;
 	}
-
-	return 0;
+	ring->lines[ring->end & (ring->maxlines - 1)] = ring->head;
+	ring->end++;
 }
 
-MC_API int mc_input_char(struct mc_console *con, char key)
+// Evict the oldest lines until len more bytes fit after the head
+static void _mc_ring_reserve(struct mc_ring *ring, unsigned len)
 {
-	MC_ASSERT(con);
-	if(key == '\0'){
-		return -1;
+	while(ring->head + len - _mc_ring_line_start(ring, ring->first) > ring->size){
+		if(ring->first + 1 == ring->end){
+			// The last line is longer than the ring, drop its start
+			ring->lines[ring->first & (ring->maxlines - 1)] = ring->head + len - ring->size;
+			break;
+		}
+		ring->first++;
 	}
+}
 
-	if(key >= ' ' && key <= '~'){
-
+// Append bytes that don't contain a newline to the last line, evicting the oldest lines to make room
+static void _mc_ring_put(struct mc_ring *ring, const char *str, unsigned len)
+{
+	if(len > ring->size){
+		// Only the tail of a write that doesn't fit at all is kept
+		ring->head += len - ring->size;
+		str += len - ring->size;
+		len = ring->size;
 	}
 
-	switch(key){
-		case '\n':
+	_mc_ring_reserve(ring, len);
 
-			break;
-		case '\t':
+	unsigned offset = ring->head & (ring->size - 1);
+	unsigned n = len < ring->size - offset ? len : ring->size - offset;
+	memcpy(ring->data + offset, str, n);
+	memcpy(ring->data, str + n, len - n);
+	ring->head += len;
+}
 
-			break;
+static void _mc_ring_write(struct mc_ring *ring, const char *str, unsigned len)
+{
+	while(len > 0){
+		const char *newline = (const char*)memchr(str, '\n', len);
+		unsigned n = newline ? (unsigned)(newline - str) : len;
+		_mc_ring_put(ring, str, n);
+		if(newline){
+			// The newline is stored as well so lines end right before the start of the next one
+			_mc_ring_put(ring, "\n", 1);
+			_mc_ring_new_line(ring);
+			n++;
+		}
+		str += n;
+		len -= n;
 	}
-
-	return 0;
 }
 
-// Font converted with ccfconv (ccFont) from Pixerif and converted to binary with xxd
-static unsigned char _mc_default_font_bin[] = {
-  0x01, 0x0c, 0x0f, 0x21, 0x80, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x5a,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0e, 0xe0,
-  0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0,
-  0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0,
-  0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0,
-  0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x0e, 0xe0,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x03, 0x00, 0x00, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x01, 0x50, 0x00, 0x28, 0xe0, 0x01, 0x26, 0xc0, 0x01, 0x02, 0x40,
-  0x00, 0x01, 0x50, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0xc0,
-  0x00, 0x02, 0xf0, 0x00, 0x0f, 0x40, 0x00, 0x1f, 0xc0, 0x00, 0x1f, 0xe0,
-  0x00, 0x0e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x80,
-  0x07, 0x08, 0xf0, 0x00, 0x1c, 0xf0, 0x00, 0x1f, 0xf0, 0x01, 0x1c, 0x70,
-  0x07, 0x07, 0xe0, 0x00, 0x77, 0x70, 0x00, 0xc3, 0x30, 0x07, 0x0c, 0xf0,
-  0x00, 0x0c, 0xf0, 0x00, 0x1e, 0xf0, 0x01, 0x77, 0x70, 0x07, 0x07, 0x77,
-  0x07, 0x77, 0xf0, 0x01, 0x07, 0x10, 0x00, 0x07, 0x80, 0x00, 0x00, 0x20,
-  0x00, 0x00, 0x30, 0x00, 0x00, 0xc0, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x30,
-  0x00, 0x02, 0x20, 0x00, 0x03, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x04, 0x10, 0x00, 0x04, 0x00, 0x00, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x01, 0x50, 0x00, 0x28, 0x50, 0x01, 0x29, 0x20, 0x01, 0x02, 0x20,
-  0x00, 0x02, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x20,
-  0x01, 0x03, 0x00, 0x01, 0x11, 0x40, 0x00, 0x01, 0x20, 0x00, 0x10, 0x10,
-  0x01, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x40,
-  0x08, 0x08, 0x20, 0x01, 0x12, 0x20, 0x01, 0x12, 0x20, 0x01, 0x12, 0x20,
-  0x02, 0x02, 0x80, 0x00, 0x22, 0x20, 0x00, 0x66, 0x60, 0x02, 0x12, 0x20,
-  0x01, 0x12, 0x20, 0x01, 0x11, 0x50, 0x01, 0x22, 0x20, 0x02, 0x02, 0x22,
-  0x02, 0x22, 0x10, 0x01, 0x01, 0x10, 0x00, 0x04, 0x40, 0x01, 0x00, 0x00,
-  0x00, 0x00, 0x20, 0x00, 0x00, 0x80, 0x00, 0x00, 0x20, 0x00, 0x00, 0x20,
-  0x00, 0x00, 0x00, 0x00, 0x02, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x04, 0x10, 0x00, 0x04, 0x00, 0x00, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x01, 0x00, 0x00, 0x7e, 0x50, 0x00, 0x19, 0x20, 0x00, 0x00, 0x10,
-  0x00, 0x04, 0xe0, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x10,
-  0x02, 0x02, 0x00, 0x01, 0x10, 0x20, 0x00, 0x01, 0x10, 0x00, 0x08, 0x10,
-  0x01, 0x11, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x60, 0x00, 0x10, 0x20,
-  0x17, 0x14, 0x20, 0x01, 0x01, 0x20, 0x02, 0x02, 0x20, 0x00, 0x01, 0x20,
-  0x02, 0x02, 0x80, 0x00, 0x12, 0x20, 0x00, 0x66, 0x60, 0x02, 0x21, 0x20,
-  0x01, 0x21, 0x20, 0x01, 0x01, 0x40, 0x00, 0x22, 0x20, 0x02, 0x22, 0x42,
-  0x01, 0x14, 0x80, 0x00, 0x01, 0x20, 0x00, 0x04, 0x20, 0x02, 0x00, 0x00,
-  0x00, 0x07, 0xe0, 0x00, 0x0e, 0xe0, 0x00, 0x06, 0x70, 0x00, 0x16, 0xe0,
-  0x00, 0x03, 0x30, 0x00, 0x12, 0x10, 0x00, 0x6d, 0xd0, 0x00, 0x06, 0xd0,
-  0x00, 0x16, 0xd0, 0x00, 0x0e, 0x70, 0x00, 0x1b, 0x70, 0x07, 0xc7, 0x31,
-  0x03, 0x33, 0xf0, 0x00, 0x04, 0x10, 0x00, 0x04, 0x00, 0x00, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x01, 0x00, 0x00, 0x14, 0xe0, 0x00, 0x16, 0x60, 0x0e, 0x00, 0x10,
-  0x00, 0x04, 0x50, 0x01, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x10,
-  0x02, 0x02, 0x80, 0x00, 0x0c, 0xa0, 0x00, 0x0f, 0xf0, 0x00, 0x08, 0xe0,
-  0x00, 0x11, 0x10, 0x00, 0x01, 0x80, 0x01, 0x7e, 0x80, 0x01, 0x08, 0x90,
-  0x14, 0x14, 0xe0, 0x01, 0x01, 0x20, 0x02, 0x0e, 0xe0, 0x00, 0x01, 0xe0,
-  0x03, 0x02, 0x80, 0x00, 0x0e, 0x20, 0x00, 0x5a, 0xa0, 0x02, 0x21, 0xe0,
-  0x00, 0x21, 0xe0, 0x00, 0x0e, 0x40, 0x00, 0x22, 0x20, 0x02, 0x22, 0x82,
-  0x00, 0x08, 0x40, 0x00, 0x01, 0x20, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x08, 0x20, 0x01, 0x09, 0x90, 0x00, 0x09, 0x20, 0x00, 0x09, 0x20,
-  0x01, 0x02, 0x20, 0x00, 0x0a, 0x10, 0x00, 0x92, 0x20, 0x01, 0x09, 0x20,
-  0x01, 0x09, 0xa0, 0x00, 0x01, 0x20, 0x00, 0x12, 0x20, 0x02, 0x82, 0x20,
-  0x01, 0x12, 0x90, 0x00, 0x04, 0x10, 0x00, 0x04, 0x60, 0x00, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x01, 0x00, 0x00, 0x14, 0x40, 0x01, 0x68, 0x90, 0x04, 0x00, 0x10,
-  0x00, 0x04, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x0f, 0x00, 0x00, 0x02, 0x10,
-  0x02, 0x02, 0x40, 0x00, 0x10, 0x90, 0x00, 0x10, 0x10, 0x01, 0x04, 0x10,
-  0x01, 0x1e, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x06, 0x04, 0x50,
-  0x14, 0x1c, 0x20, 0x02, 0x01, 0x20, 0x02, 0x02, 0x20, 0x00, 0x19, 0x20,
-  0x02, 0x02, 0x80, 0x00, 0x0a, 0x20, 0x00, 0x5a, 0xa0, 0x02, 0x21, 0x20,
-  0x00, 0x21, 0xa0, 0x00, 0x10, 0x40, 0x00, 0x22, 0x40, 0x01, 0x54, 0x81,
-  0x00, 0x08, 0x20, 0x00, 0x01, 0x40, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x0e, 0x20, 0x01, 0x01, 0x90, 0x00, 0x0f, 0x20, 0x00, 0x09, 0x20,
-  0x01, 0x02, 0x20, 0x00, 0x06, 0x10, 0x00, 0x92, 0x20, 0x01, 0x09, 0x20,
-  0x01, 0x09, 0x20, 0x00, 0x06, 0x20, 0x00, 0x12, 0x20, 0x02, 0x92, 0xc0,
-  0x00, 0x12, 0x40, 0x00, 0x03, 0x10, 0x00, 0x18, 0x90, 0x04, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x01, 0x00, 0x00, 0x3f, 0x40, 0x01, 0x98, 0x10, 0x05, 0x00, 0x10,
-  0x00, 0x04, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x10,
-  0x02, 0x02, 0x20, 0x00, 0x10, 0xf0, 0x01, 0x10, 0x10, 0x01, 0x04, 0x10,
-  0x01, 0x10, 0x00, 0x00, 0x00, 0x80, 0x01, 0x7e, 0x80, 0x01, 0x02, 0x50,
-  0x12, 0x22, 0x20, 0x02, 0x01, 0x20, 0x02, 0x02, 0x20, 0x00, 0x11, 0x20,
-  0x02, 0x02, 0x80, 0x00, 0x12, 0x20, 0x00, 0x42, 0x20, 0x03, 0x21, 0x20,
-  0x00, 0x29, 0x20, 0x01, 0x10, 0x40, 0x00, 0x22, 0x40, 0x01, 0x54, 0x41,
-  0x01, 0x08, 0x10, 0x00, 0x01, 0x40, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x09, 0x20, 0x01, 0x01, 0x90, 0x00, 0x01, 0x20, 0x00, 0x09, 0x20,
-  0x01, 0x02, 0x20, 0x00, 0x0a, 0x10, 0x00, 0x92, 0x20, 0x01, 0x09, 0x20,
-  0x01, 0x09, 0x20, 0x00, 0x08, 0x20, 0x00, 0x12, 0x40, 0x01, 0x54, 0xc0,
-  0x00, 0x0c, 0x20, 0x00, 0x04, 0x10, 0x00, 0x04, 0x00, 0x03, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x00, 0x00, 0x00, 0x0a, 0x50, 0x01, 0x94, 0x10, 0x02, 0x00, 0x20,
-  0x00, 0x02, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x20,
-  0x01, 0x02, 0x10, 0x01, 0x11, 0x80, 0x00, 0x11, 0x10, 0x01, 0x02, 0x10,
-  0x01, 0x08, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x60, 0x00, 0x00, 0x90,
-  0x0f, 0x22, 0x20, 0x02, 0x12, 0x20, 0x01, 0x12, 0x20, 0x00, 0x12, 0x20,
-  0x02, 0x02, 0x90, 0x00, 0x22, 0x20, 0x01, 0x42, 0x20, 0x03, 0x12, 0x20,
-  0x00, 0x12, 0x20, 0x01, 0x11, 0x40, 0x00, 0x22, 0x80, 0x00, 0x88, 0x20,
-  0x02, 0x08, 0x10, 0x01, 0x01, 0x80, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x09, 0x20, 0x01, 0x09, 0x90, 0x00, 0x09, 0x20, 0x00, 0x09, 0x20,
-  0x01, 0x02, 0x20, 0x00, 0x0a, 0x10, 0x00, 0x92, 0x20, 0x01, 0x09, 0x20,
-  0x01, 0x09, 0x20, 0x00, 0x09, 0x20, 0x00, 0x12, 0x40, 0x01, 0x54, 0x20,
-  0x01, 0x0c, 0x90, 0x00, 0x04, 0x10, 0x00, 0x04, 0x00, 0x00, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00, 0x01, 0x10, 0x00,
-  0x01, 0x01, 0x00, 0x00, 0x0a, 0xf0, 0x00, 0x64, 0xe0, 0x0d, 0x00, 0x40,
-  0x00, 0x01, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x00, 0x01, 0xc0,
-  0x00, 0x07, 0xf0, 0x01, 0x0f, 0x80, 0x00, 0x0f, 0xe0, 0x00, 0x02, 0xe0,
-  0x00, 0x07, 0x10, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x20,
-  0x20, 0x77, 0xf0, 0x01, 0x1c, 0xf0, 0x00, 0x1f, 0x70, 0x00, 0x1c, 0x70,
-  0x07, 0x07, 0x60, 0x00, 0x77, 0xf0, 0x01, 0xe7, 0x70, 0x02, 0x0c, 0x70,
-  0x00, 0x6c, 0x70, 0x03, 0x0f, 0xe0, 0x00, 0x1c, 0x80, 0x00, 0x88, 0x70,
-  0x07, 0x1c, 0xf0, 0x01, 0x07, 0x80, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x1e, 0xd0, 0x00, 0x0e, 0x60, 0x01, 0x0e, 0x70, 0x00, 0x0e, 0x70,
-  0x03, 0x07, 0x20, 0x00, 0x17, 0x60, 0x00, 0xb7, 0x71, 0x03, 0x06, 0xe0,
-  0x00, 0x0e, 0x70, 0x00, 0x07, 0x40, 0x00, 0x2c, 0x80, 0x00, 0x28, 0x30,
-  0x03, 0x08, 0xf0, 0x00, 0x04, 0x10, 0x00, 0x04, 0x00, 0x00, 0x1e, 0xe0,
-  0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0,
-  0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0,
-  0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0,
-  0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0, 0x01, 0x1e, 0xe0,
-  0x01, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0,
-  0x1f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7f, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00,
-  0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20,
-  0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x04, 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00,
-  0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70,
-  0x00, 0x1c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x06, 0x00, 0x00, 0x18, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00
-};
-
-static bool _mc_default_font_is_allocated = false;
-static int _mc_default_font_glyph_width, _mc_default_font_glyph_height, _mc_default_font_glyph_start, _mc_default_font_glyph_num;
-static unsigned _mc_default_font_width;
-static unsigned char *_mc_default_font_data;
-
-static int _mc_font_allocate()
-{
-	if(_mc_default_font_is_allocated){
-		return 0;
-	}
+// Every arena block starts with its size and is aligned for any type
+#define _MC_ARENA_ALIGN 16
 
-	if(_mc_default_font_bin[0] != 1){
+static void *_mc_arena_alloc(struct mc_console *con, size_t size)
+{
+	size_t rounded = (size + _MC_ARENA_ALIGN - 1) & ~(size_t)(_MC_ARENA_ALIGN - 1);
+	if(rounded < size || con->arenasize - con->arenaused < rounded + _MC_ARENA_ALIGN){
+		return NULL;
+	}
+
+	char *ptr = con->arena + con->arenaused + _MC_ARENA_ALIGN;
+	*(size_t*)(ptr - sizeof(size_t)) = size;
+	con->arenaused += rounded + _MC_ARENA_ALIGN;
+	con->arenalast = ptr;
+
+	return ptr;
+}
+
+// Only the dynamic arrays and the texture are resized
+#if defined MC_DYNAMIC_ARRAYS || defined MC_OUTPUT_TEXTURE
+static void *_mc_arena_realloc(struct mc_console *con, void *ptr, size_t size)
+{
+	if(!ptr){
+		return _mc_arena_alloc(con, size);
+	}
+
+	size_t oldsize = *(size_t*)((char*)ptr - sizeof(size_t));
+	if((char*)ptr == con->arenalast){
+		// The newest block grows or shrinks in place
+		size_t start = (char*)ptr - con->arena;
+		size_t rounded = (size + _MC_ARENA_ALIGN - 1) & ~(size_t)(_MC_ARENA_ALIGN - 1);
+		if(rounded < size || con->arenasize - start < rounded){
+			return NULL;
+		}
+		*(size_t*)((char*)ptr - sizeof(size_t)) = size;
+		con->arenaused = start + rounded;
+		return ptr;
+	}
+
+	void *newptr = _mc_arena_alloc(con, size);
+	if(newptr){
+		memcpy(newptr, ptr, oldsize < size ? oldsize : size);
+	}
+
+	return newptr;
+}
+#endif
+
+static void *_mc_malloc(struct mc_console *con, size_t size)
+{
+	if(con->arena){
+		return _mc_arena_alloc(con, size);
+	}
+	if(con->allocator.malloc){
+		return con->allocator.malloc(con->allocator.user, size);
+	}
+
+	return MC_MALLOC(size);
+}
+
+#if defined MC_DYNAMIC_ARRAYS || defined MC_OUTPUT_TEXTURE
+static void *_mc_realloc(struct mc_console *con, void *ptr, size_t size)
+{
+	if(con->arena){
+		return _mc_arena_realloc(con, ptr, size);
+	}
+	if(con->allocator.realloc){
+		return con->allocator.realloc(con->allocator.user, ptr, size);
+	}
+
+	return MC_REALLOC(ptr, size);
+}
+#endif
+
+static void _mc_free(struct mc_console *con, void *ptr)
+{
+	if(!ptr){
+		return;
+	}
+
+	if(con->arena){
+		if((char*)ptr == con->arenalast){
+			con->arenaused = (char*)ptr - con->arena - _MC_ARENA_ALIGN;
+			con->arenalast = NULL;
+		}
+		return;
+	}
+	if(con->allocator.free){
+		con->allocator.free(con->allocator.user, ptr);
+		return;
+	}
+
+	MC_FREE(ptr);
+}
+
+#ifdef MC_MULTITHREADED
+static int _mc_worker(void *arg)
+{
+	struct mc_console *con = (struct mc_console*)arg;
+
+	mtx_lock(&con->jobmutex);
+	for(;;){
+		while(con->jobqueue < 0 && !con->jobquit){
+			cnd_wait(&con->jobcond, &con->jobmutex);
+		}
+		if(con->jobqueue < 0){
+			break;
+		}
+
+		struct mc_job *job = con->jobs + con->jobqueue;
+		con->jobqueue = job->next;
+		if(con->jobqueue < 0){
+			con->jobqueuetail = -1;
+		}
+		mtx_unlock(&con->jobmutex);
+
+#ifdef MC_STATS
+		double start = MC_STATS_TIME();
+#endif
+		job->result = atomic_load(&job->cancelled) ? -1 : job->func(job, job->argc, job->argv);
+#ifdef MC_STATS
+		job->time = MC_STATS_TIME() - start;
+#endif
+
+		mtx_lock(&con->jobmutex);
+		job->next = con->jobfinished;
+		con->jobfinished = job - con->jobs;
+	}
+	mtx_unlock(&con->jobmutex);
+
+	return 0;
+}
+
+// The workers are only started when the first async command runs
+static int _mc_jobs_start(struct mc_console *con)
+{
+	con->jobs = (struct mc_job*)_mc_malloc(con, MC_MAX_JOBS * sizeof(struct mc_job));
+	if(!con->jobs){
+		return -1;
+	}
+
+	int i;
+	for(i = 0; i < MC_MAX_JOBS; i++){
+		con->jobs[i].next = i + 1 < MC_MAX_JOBS ? i + 1 : -1;
+		atomic_init(&con->jobs[i].cancelled, false);
+	}
+	con->jobfree = 0;
+	con->jobqueue = con->jobqueuetail = con->jobfinished = -1;
+	con->jobquit = false;
+
+	if(mtx_init(&con->jobmutex, mtx_plain) != thrd_success){
+		goto nomutex;
+	}
+	if(cnd_init(&con->jobcond) != thrd_success){
+		goto nocond;
+	}
+	for(con->nworkers = 0; con->nworkers < MC_WORKERS; con->nworkers++){
+		if(thrd_create(con->workers + con->nworkers, _mc_worker, con) != thrd_success){
+			break;
+		}
+	}
+	if(con->nworkers > 0){
+		return 0;
+	}
+
+	cnd_destroy(&con->jobcond);
+nocond:
+	mtx_destroy(&con->jobmutex);
+nomutex:
+	_mc_free(con, con->jobs);
+	con->jobs = NULL;
+
+	return -1;
+}
+
+static void _mc_jobs_stop(struct mc_console *con)
+{
+	if(con->nworkers == 0){
+		return;
+	}
+
+	// Wait for the commands that are running, the others are skipped
+	mc_cancel_jobs(con);
+	mtx_lock(&con->jobmutex);
+	con->jobquit = true;
+	cnd_broadcast(&con->jobcond);
+	mtx_unlock(&con->jobmutex);
+
+	unsigned i;
+	for(i = 0; i < con->nworkers; i++){
+		thrd_join(con->workers[i], NULL);
+	}
+	cnd_destroy(&con->jobcond);
+	mtx_destroy(&con->jobmutex);
+	con->nworkers = 0;
+}
+#endif
+
+#ifdef MC_STATS
+static void _mc_stats_cmd(struct mc_console *con, int argc, char **argv);
+#endif
+#ifdef MC_OUTPUT_TEXTURE
+static void _mc_palette_default(struct mc_console *con);
+#endif
+
+static int _mc_create(struct mc_console *con)
+{
+	MC_ASSERT((MC_OUTPUT_SIZE & (MC_OUTPUT_SIZE - 1)) == 0);
+	MC_ASSERT((MC_MAX_OUTPUT_LINES & (MC_MAX_OUTPUT_LINES - 1)) == 0);
+	MC_ASSERT((MC_MAX_COLOR_SPANS & (MC_MAX_COLOR_SPANS - 1)) == 0);
+	MC_ASSERT((MC_HISTORY_SIZE & (MC_HISTORY_SIZE - 1)) == 0);
+	MC_ASSERT(MC_MAX_HISTORY > 1 && (MC_MAX_HISTORY & (MC_MAX_HISTORY - 1)) == 0);
+
+	// Set up first, mc_free cleans up a console that failed halfway
+#ifdef MC_ATTACH
+	int source;
+	for(source = 0; source < MC_MAX_ATTACHED; source++){
+		con->attached[source].fd = -1;
+	}
+#endif
+
+#ifdef MC_DYNAMIC_ARRAYS
+	// The input line grows by doubling from here
+	con->incap = 32;
+	con->instr = (char*)_mc_malloc(con, con->incap);
+	char *outbuf = (char*)_mc_malloc(con, MC_OUTPUT_SIZE);
+	unsigned *outlinebuf = (unsigned*)_mc_malloc(con, MC_MAX_OUTPUT_LINES * sizeof(unsigned));
+	char *histbuf = (char*)_mc_malloc(con, MC_HISTORY_SIZE);
+	unsigned *histlinebuf = (unsigned*)_mc_malloc(con, MC_MAX_HISTORY * sizeof(unsigned));
+	con->outwrap = (struct _mc_wrap*)_mc_malloc(con, MC_MAX_OUTPUT_LINES * sizeof(struct _mc_wrap));
+	con->outtree = (unsigned*)_mc_malloc(con, MC_MAX_OUTPUT_LINES * sizeof(unsigned));
+	con->spans = (struct _mc_span*)_mc_malloc(con, MC_MAX_COLOR_SPANS * sizeof(struct _mc_span));
+	if(!con->instr || !outbuf || !outlinebuf || !histbuf || !histlinebuf || !con->outwrap || !con->outtree || !con->spans){
+		con->out.data = outbuf;
+		con->out.lines = outlinebuf;
+		con->hist.data = histbuf;
+		con->hist.lines = histlinebuf;
+		mc_free(con);
+		return -1;
+	}
+	memset(con->outtree, 0, MC_MAX_OUTPUT_LINES * sizeof(unsigned));
+	_mc_ring_init(&con->out, outbuf, MC_OUTPUT_SIZE, outlinebuf, MC_MAX_OUTPUT_LINES);
+	_mc_ring_init(&con->hist, histbuf, MC_HISTORY_SIZE, histlinebuf, MC_MAX_HISTORY);
+#else
+	con->incap = MC_MAX_INPUT_LENGTH;
+	_mc_ring_init(&con->out, con->outbuf, MC_OUTPUT_SIZE, con->outlinebuf, MC_MAX_OUTPUT_LINES);
+	_mc_ring_init(&con->hist, con->histbuf, MC_HISTORY_SIZE, con->histlinebuf, MC_MAX_HISTORY);
+#endif
+
+	con->ingapend = con->incap;
+	con->insert = true;
+	con->outsgr.fg = MC_DEFAULT_FG;
+	con->outsgr.bg = MC_DEFAULT_BG;
+
+	// No slot has a line yet, every one counts as a single row
+	unsigned slot;
+	for(slot = 0; slot < MC_MAX_OUTPUT_LINES; slot++){
+		con->outwrap[slot].line = _MC_NO_LINE;
+		con->outwrap[slot].rows = 1;
+	}
+
+#ifdef MC_MULTITHREADED
+	MC_ASSERT((MC_LOG_QUEUE_SIZE & (MC_LOG_QUEUE_SIZE - 1)) == 0);
+	con->logqueue = (struct mc_log_record*)_mc_malloc(con, MC_LOG_QUEUE_SIZE * sizeof(struct mc_log_record));
+	if(!con->logqueue){
+		mc_free(con);
+		return -1;
+	}
+	unsigned i;
+	for(i = 0; i < MC_LOG_QUEUE_SIZE; i++){
+		atomic_init(&con->logqueue[i].seq, i);
+	}
+	atomic_init(&con->logenqueue, 0);
+	atomic_init(&con->logdequeue, 0);
+	atomic_init(&con->logdropped, 0);
+	atomic_init(&con->loghighwater, 0);
+#endif
+
+#ifdef MC_OUTPUT_TEXTURE
+	con->font = mc_font_default();
+	con->glyphcachesize = MC_GLYPH_CACHE_SIZE;
+	_mc_palette_default(con);
+#ifdef MC_MULTITHREADED
+	con->nrenderthreads = 1;
+#endif
+#endif
+
+#ifdef MC_STATS
+	if(mc_map(con, "stats", _mc_stats_cmd)){
+		mc_free(con);
+		return -1;
+	}
+#endif
+
+	return 0;
+}
+
+MC_API int mc_create(struct mc_console *con)
+{
+	return mc_create_with_allocator(con, NULL);
+}
+
+MC_API int mc_create_with_allocator(struct mc_console *con, const struct mc_allocator *allocator)
+{
+	MC_ASSERT(con);
+	memset(con, 0, sizeof(struct mc_console));
+
+	if(allocator){
+		MC_ASSERT(allocator->malloc && allocator->realloc && allocator->free);
+		con->allocator = *allocator;
+	}
+
+	return _mc_create(con);
+}
+
+MC_API int mc_create_with_arena(struct mc_console *con, const struct mc_allocator *allocator, void *memory, size_t size)
+{
+	MC_ASSERT(con);
+	memset(con, 0, sizeof(struct mc_console));
+
+	if(allocator){
+		MC_ASSERT(allocator->malloc && allocator->realloc && allocator->free);
+		con->allocator = *allocator;
+	}
+	if(!memory){
+		memory = allocator ? allocator->malloc(allocator->user, size) : MC_MALLOC(size);
+		if(!memory){
+			return -1;
+		}
+		con->arenablock = memory;
+	}
+
+	size_t skip = (_MC_ARENA_ALIGN - (uintptr_t)memory % _MC_ARENA_ALIGN) % _MC_ARENA_ALIGN;
+	con->arena = (char*)memory + skip;
+	con->arenasize = size > skip ? size - skip : 0;
+
+	return _mc_create(con);
+}
+
+MC_API int mc_free(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+#ifdef MC_MULTITHREADED
+	_mc_jobs_stop(con);
+#ifdef MC_OUTPUT_TEXTURE
+	mc_set_render_threads(con, 1);
+#endif
+#endif
+#ifdef MC_OUTPUT_TEXTURE
+	mc_font_release(con->font);
+#endif
+#ifdef MC_ATTACH
+	int source;
+	for(source = 0; source < MC_MAX_ATTACHED; source++){
+		if(con->attached[source].fd >= 0){
+			mc_detach(con, source);
+		}
+	}
+#endif
+
+	if(con->arena){
+		// Everything came from the arena
+		if(con->arenablock){
+			if(con->allocator.free){
+				con->allocator.free(con->allocator.user, con->arenablock);
+			}else{
+				MC_FREE(con->arenablock);
+			}
+		}
+		return 0;
+	}
+
+	_mc_free(con, con->cells);
+#ifdef MC_MULTITHREADED
+	_mc_free(con, con->logqueue);
+	_mc_free(con, con->jobs);
+#endif
+#ifdef MC_DYNAMIC_ARRAYS
+	_mc_free(con, con->out.data);
+	_mc_free(con, con->out.lines);
+	_mc_free(con, con->outwrap);
+	_mc_free(con, con->outtree);
+	_mc_free(con, con->spans);
+	_mc_free(con, con->hist.data);
+	_mc_free(con, con->hist.lines);
+	_mc_free(con, con->instr);
+	_mc_free(con, con->killbuf);
+	_mc_free(con, con->search);
+	_mc_free(con, con->execbuf);
+	_mc_free(con, con->cmds);
+	_mc_free(con, con->cmdnames);
+	_mc_free(con, con->cmdslots);
+	_mc_free(con, con->cvars);
+	_mc_free(con, con->trie);
+#endif
+#ifdef MC_OUTPUT_TEXTURE
+	_mc_free(con, con->pixels);
+	_mc_free(con, con->glyphcache);
+#ifdef MC_MULTITHREADED
+	_mc_free(con, con->bands);
+#endif
+#endif
+
+	return 0;
+}
+
+static uint32_t _mc_hash(const char *str, unsigned len)
+{
+	uint32_t h = 2166136261u;
+	unsigned i;
+	for(i = 0; i < len; i++){
+		h = (h ^ (unsigned char)str[i]) * 16777619u;
+	}
+
+	return h;
+}
+
+static unsigned _mc_cmd_slot_count(struct mc_console *con)
+{
+#ifdef MC_DYNAMIC_ARRAYS
+	return con->ncmdslots;
+#else
+	return _MC_COMMAND_SLOTS;
+#endif
+}
+
+// Returns the index of the command or -1 when it's not registered
+static int _mc_find(struct mc_console *con, const char *name, unsigned len)
+{
+	unsigned mask = _mc_cmd_slot_count(con) - 1;
+	if(mask + 1 == 0){
+		return -1;
+	}
+
+	uint32_t hash = _mc_hash(name, len);
+	unsigned i;
+	for(i = hash & mask; con->cmdslots[i] != 0; i = (i + 1) & mask){
+		struct mc_command *cmd = con->cmds + con->cmdslots[i] - 1;
+		if(cmd->hash == hash && cmd->namelen == len && memcmp(con->cmdnames + cmd->name, name, len) == 0){
+			return con->cmdslots[i] - 1;
+		}
+	}
+
+	return -1;
+}
+
+static void _mc_cmd_slot_insert(struct mc_console *con, unsigned index)
+{
+	unsigned mask = _mc_cmd_slot_count(con) - 1;
+	unsigned i;
+	for(i = con->cmds[index].hash & mask; con->cmdslots[i] != 0; i = (i + 1) & mask);
+	con->cmdslots[i] = index + 1;
+}
+
+#ifdef MC_DYNAMIC_ARRAYS
+// Grow the arrays geometrically so registering is amortized constant time
+static int _mc_cmd_reserve(struct mc_console *con, unsigned namelen)
+{
+	if(con->ncmds == con->cmdcap){
+		unsigned cap = con->cmdcap ? con->cmdcap * 2 : 16;
+		struct mc_command *cmds = (struct mc_command*)_mc_realloc(con, con->cmds, cap * sizeof(struct mc_command));
+		if(!cmds){
+			return -1;
+		}
+		con->cmds = cmds;
+		con->cmdcap = cap;
+	}
+
+	if(con->cmdnameslen + namelen + 1 > con->cmdnamescap){
+		unsigned cap = con->cmdnamescap ? con->cmdnamescap * 2 : 256;
+		while(con->cmdnameslen + namelen + 1 > cap){
+			cap *= 2;
+		}
+		char *names = (char*)_mc_realloc(con, con->cmdnames, cap);
+		if(!names){
+			return -1;
+		}
+		con->cmdnames = names;
+		con->cmdnamescap = cap;
+	}
+
+	// Keep the table at most half full
+	if((con->ncmds + 1) * 2 > con->ncmdslots){
+		unsigned nslots = con->ncmdslots ? con->ncmdslots * 2 : 32;
+		unsigned *slots = (unsigned*)_mc_malloc(con, nslots * sizeof(unsigned));
+		if(!slots){
+			return -1;
+		}
+		memset(slots, 0, nslots * sizeof(unsigned));
+		_mc_free(con, con->cmdslots);
+		con->cmdslots = slots;
+		con->ncmdslots = nslots;
+
+		unsigned i;
+		for(i = 0; i < con->ncmds; i++){
+			_mc_cmd_slot_insert(con, i);
+		}
+	}
+
+	return 0;
+}
+#endif
+
+static int _mc_trie_new(struct mc_console *con)
+{
+#ifdef MC_DYNAMIC_ARRAYS
+	if(con->ntrie == con->triecap){
+		unsigned cap = con->triecap ? con->triecap * 2 : 32;
+		struct mc_trie_node *trie = (struct mc_trie_node*)_mc_realloc(con, con->trie, cap * sizeof(struct mc_trie_node));
+		if(!trie){
+			return -1;
+		}
+		con->trie = trie;
+		con->triecap = cap;
+	}
+#else
+	if(con->ntrie == _MC_TRIE_NODES){
+		return -1;
+	}
+#endif
+
+	int n = con->ntrie++;
+	memset(con->trie + n, 0, sizeof(struct mc_trie_node));
+	con->trie[n].parent = con->trie[n].child = con->trie[n].sibling = con->trie[n].cmd = -1;
+
+	return n;
+}
+
+static char _mc_trie_char(struct mc_console *con, int node, unsigned i)
+{
+	return con->cmdnames[con->trie[node].label + i];
+}
+
+// Add the name of a command to the radix tree, splitting the edge it diverges from
+static int _mc_trie_insert(struct mc_console *con, int cmd)
+{
+	if(con->ntrie == 0 && _mc_trie_new(con) < 0){
+		return -1;
+	}
+
+	const char *name = con->cmdnames + con->cmds[cmd].name;
+	unsigned len = con->cmds[cmd].namelen, pos = 0;
+	int node = 0;
+	while(pos < len){
+		// Children are sorted on the first character of their label
+		int prev = -1, child = con->trie[node].child;
+		while(child >= 0 && (unsigned char)_mc_trie_char(con, child, 0) < (unsigned char)name[pos]){
+			prev = child;
+			child = con->trie[child].sibling;
+		}
+
+		if(child < 0 || _mc_trie_char(con, child, 0) != name[pos]){
+			int leaf = _mc_trie_new(con);
+			if(leaf < 0){
+				return -1;
+			}
+			struct mc_trie_node *n = con->trie + leaf;
+			n->label = con->cmds[cmd].name + pos;
+			n->labellen = len - pos;
+			n->depth = len;
+			n->parent = node;
+			n->sibling = child;
+			n->cmd = n->any = cmd;
+			if(prev >= 0){
+				con->trie[prev].sibling = leaf;
+			}else{
+				con->trie[node].child = leaf;
+			}
+			return 0;
+		}
+
+		unsigned common = 1;
+		while(common < con->trie[child].labellen && pos + common < len && _mc_trie_char(con, child, common) == name[pos + common]){
+			common++;
+		}
+
+		if(common < con->trie[child].labellen){
+			int mid = _mc_trie_new(con);
+			if(mid < 0){
+				return -1;
+			}
+			struct mc_trie_node *m = con->trie + mid, *c = con->trie + child;
+			m->label = c->label;
+			m->labellen = common;
+			m->depth = con->trie[node].depth + common;
+			m->parent = node;
+			m->child = child;
+			m->sibling = c->sibling;
+			m->any = c->any;
+			if(prev >= 0){
+				con->trie[prev].sibling = mid;
+			}else{
+				con->trie[node].child = mid;
+			}
+			c->label += common;
+			c->labellen -= common;
+			c->parent = mid;
+			c->sibling = -1;
+			child = mid;
+		}
+
+		node = child;
+		pos += common;
+	}
+
+	con->trie[node].cmd = cmd;
+	if(node == 0){
+		con->trie[node].any = cmd;
+	}
+
+	return 0;
+}
+
+// Find the node where all names starting with prefix are below, or -1 when there are none
+static int _mc_trie_find(struct mc_console *con, const char *prefix, unsigned len)
+{
+	if(con->ntrie == 0){
+		return -1;
+	}
+
+	int node = 0;
+	unsigned pos = 0;
+	while(pos < len){
+		int child = con->trie[node].child;
+		while(child >= 0 && _mc_trie_char(con, child, 0) != prefix[pos]){
+			child = con->trie[child].sibling;
+		}
+		if(child < 0){
+			return -1;
+		}
+
+		unsigned i;
+		for(i = 1; i < con->trie[child].labellen && pos + i < len; i++){
+			if(_mc_trie_char(con, child, i) != prefix[pos + i]){
+				return -1;
+			}
+		}
+
+		node = child;
+		pos += i;
+	}
+
+	return node;
+}
+
+// Next node in sorted order below root, or -1 when all nodes are visited
+static int _mc_trie_next(struct mc_console *con, int node, int root)
+{
+	if(con->trie[node].child >= 0){
+		return con->trie[node].child;
+	}
+	while(node != root){
+		if(con->trie[node].sibling >= 0){
+			return con->trie[node].sibling;
+		}
+		node = con->trie[node].parent;
+	}
+
+	return -1;
+}
+
+// Commands mapped to NULL keep their slot and trie node, they're only skipped
+static bool _mc_trie_is_cmd(struct mc_console *con, int node)
+{
+	if(con->trie[node].cmd < 0){
+		return false;
+	}
+
+	const struct mc_command *cmd = con->cmds + con->trie[node].cmd;
+#ifdef MC_MULTITHREADED
+	if(cmd->async){
+		return true;
+	}
+#endif
+	return cmd->func || cmd->cvar >= 0;
+}
+
+static int _mc_trie_next_cmd(struct mc_console *con, int node, int root)
+{
+	do{
+		node = _mc_trie_next(con, node, root);
+	}while(node >= 0 && !_mc_trie_is_cmd(con, node));
+
+	return node;
+}
+
+// First command at or below the node, -1 when there is none
+static int _mc_trie_first_cmd(struct mc_console *con, int node)
+{
+	return _mc_trie_is_cmd(con, node) ? node : _mc_trie_next_cmd(con, node, node);
+}
+
+// Find or add the command, the pointer is valid until the next command is added
+static int _mc_map(struct mc_console *con, const char *cmd, struct mc_command **command)
+{
+	unsigned len = strlen(cmd);
+	int index = _mc_find(con, cmd, len);
+	if(index >= 0){
+		*command = con->cmds + index;
+		return 0;
+	}
+
+#ifdef MC_DYNAMIC_ARRAYS
+	if(_mc_cmd_reserve(con, len)){
+		return -3;
+	}
+#else
+	MC_ASSERT(con->ncmds < MC_MAX_COMMANDS);
+	if(con->ncmds == MC_MAX_COMMANDS){
+		return -1;
+	}
+	if(len >= MC_MAX_COMMAND_LENGTH || con->cmdnameslen + len + 1 > MC_MAX_COMMAND_STORAGE){
+		return -2;
+	}
+#endif
+
+	// The command only counts once it's in the trie, a failed insert leaves the name unused
+	struct mc_command *c = con->cmds + con->ncmds;
+	c->name = con->cmdnameslen;
+	c->namelen = len;
+	c->hash = _mc_hash(cmd, len);
+	c->cvar = -1;
+	memcpy(con->cmdnames + con->cmdnameslen, cmd, len + 1);
+	if(_mc_trie_insert(con, con->ncmds)){
+		return -3;
+	}
+
+	con->cmdnameslen += len + 1;
+	_mc_cmd_slot_insert(con, con->ncmds);
+	con->ncmds++;
+	*command = c;
+
+	return 0;
+}
+
+MC_API int mc_map(struct mc_console *con, const char *cmd, mc_cmd_ptr func)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(cmd);
+
+	struct mc_command *command = NULL;
+	int result = _mc_map(con, cmd, &command);
+	if(result == 0){
+		command->func = func;
+		command->cvar = -1;
+#ifdef MC_MULTITHREADED
+		command->async = NULL;
+		command->done = NULL;
+#endif
+#ifdef MC_STATS
+		command->calls = 0;
+		command->time = 0;
+#endif
+	}
+
+	return result;
+}
+
+#ifdef MC_MULTITHREADED
+MC_API int mc_map_async(struct mc_console *con, const char *cmd, mc_async_cmd_ptr func, mc_job_done_ptr done)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(cmd);
+	MC_ASSERT(func);
+
+	struct mc_command *command = NULL;
+	int result = _mc_map(con, cmd, &command);
+	if(result == 0){
+		command->func = NULL;
+		command->cvar = -1;
+		command->async = func;
+		command->done = done;
+#ifdef MC_STATS
+		command->calls = 0;
+		command->time = 0;
+#endif
+	}
+
+	return result;
+}
+#endif
+
+MC_API mc_cmd_ptr mc_find(struct mc_console *con, const char *cmd)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(cmd);
+
+	int index = _mc_find(con, cmd, strlen(cmd));
+
+	return index >= 0 ? con->cmds[index].func : NULL;
+}
+
+// Register the command of a console variable, the room for the variable is made first so a failure leaves no command behind
+static int _mc_cvar_map(struct mc_console *con, const char *name, struct _mc_cvar cvar)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(name);
+	MC_ASSERT(cvar.value);
+
+	int index = _mc_find(con, name, strlen(name));
+	if(index < 0 || con->cmds[index].cvar < 0){
+#ifdef MC_DYNAMIC_ARRAYS
+		if(con->ncvars == con->cvarcap){
+			unsigned cap = con->cvarcap ? con->cvarcap * 2 : 16;
+			struct _mc_cvar *cvars = (struct _mc_cvar*)_mc_realloc(con, con->cvars, cap * sizeof(struct _mc_cvar));
+			if(!cvars){
+				return -3;
+			}
+			con->cvars = cvars;
+			con->cvarcap = cap;
+		}
+#else
+		MC_ASSERT(con->ncvars < MC_MAX_CVARS);
+		if(con->ncvars == MC_MAX_CVARS){
+			return -1;
+		}
+#endif
+	}
+
+	struct mc_command *command = NULL;
+	int result = _mc_map(con, name, &command);
+	if(result == 0){
+		if(command->cvar < 0){
+			command->cvar = con->ncvars++;
+		}
+		cvar.cmd = command - con->cmds;
+		con->cvars[command->cvar] = cvar;
+		command->func = NULL;
+#ifdef MC_MULTITHREADED
+		command->async = NULL;
+		command->done = NULL;
+#endif
+#ifdef MC_STATS
+		command->calls = 0;
+		command->time = 0;
+#endif
+	}
+
+	return result;
+}
+
+MC_API int mc_cvar_int(struct mc_console *con, const char *name, int *value, int min, int max, mc_cvar_ptr changed)
+{
+	return _mc_cvar_map(con, name, (struct _mc_cvar){MC_CVAR_INT, value, 0, min, max, 0, NULL, changed});
+}
+
+MC_API int mc_cvar_float(struct mc_console *con, const char *name, float *value, float min, float max, mc_cvar_ptr changed)
+{
+	return _mc_cvar_map(con, name, (struct _mc_cvar){MC_CVAR_FLOAT, value, 0, min, max, 0, NULL, changed});
+}
+
+MC_API int mc_cvar_bool(struct mc_console *con, const char *name, bool *value, mc_cvar_ptr changed)
+{
+	return _mc_cvar_map(con, name, (struct _mc_cvar){MC_CVAR_BOOL, value, 0, 0, 1, 0, NULL, changed});
+}
+
+MC_API int mc_cvar_string(struct mc_console *con, const char *name, char *value, unsigned size, mc_cvar_ptr changed)
+{
+	MC_ASSERT(size > 0);
+
+	return _mc_cvar_map(con, name, (struct _mc_cvar){MC_CVAR_STRING, value, 0, 0, 0, size, NULL, changed});
+}
+
+MC_API int mc_cvar_enum(struct mc_console *con, const char *name, int *value, const char *const *names, unsigned n, mc_cvar_ptr changed)
+{
+	MC_ASSERT(names || n == 0);
+
+	return _mc_cvar_map(con, name, (struct _mc_cvar){MC_CVAR_ENUM, value, 0, 0, n, n, names, changed});
+}
+
+// Store the value that text stands for, returns 1 when the variable changed, 0 when it already had the value and -3 when it's refused
+static int _mc_cvar_parse(const struct _mc_cvar *cvar, const char *text)
+{
+	static const char *const bools[] = {"0", "false", "off", "no", "1", "true", "on", "yes"};
+	char *end;
+	unsigned i;
+	switch(cvar->type){
+		case MC_CVAR_INT:{
+			long long v = strtoll(text, &end, 0);
+			if(end == text || *end != '\0' || v < cvar->min || v > cvar->max){
+				return -3;
+			}
+			if(*(int*)cvar->value == v){
+				return 0;
+			}
+			*(int*)cvar->value = (int)v;
+			return 1;
+		}
+		case MC_CVAR_FLOAT:{
+			// NaN is never in range
+			float v = strtof(text, &end);
+			if(end == text || *end != '\0' || !(v >= cvar->min && v <= cvar->max)){
+				return -3;
+			}
+			if(*(float*)cvar->value == v){
+				return 0;
+			}
+			*(float*)cvar->value = v;
+			return 1;
+		}
+		case MC_CVAR_BOOL:
+			for(i = 0; i < sizeof(bools) / sizeof(bools[0]); i++){
+				if(strcmp(bools[i], text) == 0){
+					bool v = i >= 4;
+					if(*(bool*)cvar->value == v){
+						return 0;
+					}
+					*(bool*)cvar->value = v;
+					return 1;
+				}
+			}
+			return -3;
+		case MC_CVAR_STRING:{
+			unsigned len = strlen(text);
+			if(len >= cvar->size){
+				return -3;
+			}
+			if(strcmp((char*)cvar->value, text) == 0){
+				return 0;
+			}
+			memcpy(cvar->value, text, len + 1);
+			return 1;
+		}
+		case MC_CVAR_ENUM:
+			for(i = 0; i < cvar->size; i++){
+				if(strcmp(cvar->names[i], text) == 0){
+					if(*(int*)cvar->value == (int)i){
+						return 0;
+					}
+					*(int*)cvar->value = i;
+					return 1;
+				}
+			}
+			return -3;
+	}
+
+	return -3;
+}
+
+static int _mc_cvar_set(struct mc_console *con, const struct _mc_cvar *cvar, const char *text)
+{
+	int result = _mc_cvar_parse(cvar, text);
+	if(result < 0){
+		return result;
+	}
+	if(result > 0 && cvar->changed){
+		cvar->changed(con, con->cmdnames + con->cmds[cvar->cmd].name);
+	}
+
+	return 0;
+}
+
+static int _mc_cvar_format(const struct _mc_cvar *cvar, char *buf, unsigned buflen)
+{
+	switch(cvar->type){
+		case MC_CVAR_INT:
+			return snprintf(buf, buflen, "%d", *(int*)cvar->value);
+		case MC_CVAR_FLOAT:
+			return snprintf(buf, buflen, "%g", *(float*)cvar->value);
+		case MC_CVAR_BOOL:
+			return snprintf(buf, buflen, "%s", *(bool*)cvar->value ? "true" : "false");
+		case MC_CVAR_STRING:
+			return snprintf(buf, buflen, "%s", (char*)cvar->value);
+		case MC_CVAR_ENUM:{
+			// The caller can store anything in the variable
+			int v = *(int*)cvar->value;
+			return v >= 0 && (unsigned)v < cvar->size ? snprintf(buf, buflen, "%s", cvar->names[v]) : snprintf(buf, buflen, "%d", v);
+		}
+	}
+
+	return 0;
+}
+
+static struct _mc_cvar *_mc_cvar_find(struct mc_console *con, const char *name)
+{
+	int index = _mc_find(con, name, strlen(name));
+
+	return index >= 0 && con->cmds[index].cvar >= 0 ? con->cvars + con->cmds[index].cvar : NULL;
+}
+
+MC_API int mc_cvar_set(struct mc_console *con, const char *name, const char *value)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(name);
+	MC_ASSERT(value);
+
+	struct _mc_cvar *cvar = _mc_cvar_find(con, name);
+	if(!cvar){
+		return -2;
+	}
+
+	return _mc_cvar_set(con, cvar, value);
+}
+
+MC_API int mc_cvar_get(struct mc_console *con, const char *name, char *buf, unsigned buflen)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(name);
+	MC_ASSERT(buf || buflen == 0);
+
+	struct _mc_cvar *cvar = _mc_cvar_find(con, name);
+	if(!cvar){
+		return -2;
+	}
+
+	return _mc_cvar_format(cvar, buf, buflen);
+}
+
+// The name alone shows the variable and what it can be set to, with a value it's set
+static int _mc_cvar_cmd(struct mc_console *con, const struct _mc_cvar *cvar, int argc, char **argv)
+{
+	int result = 0;
+	if(argc == 2){
+		if(_mc_cvar_set(con, cvar, argv[1]) == 0){
+			return 0;
+		}
+		mc_printf(con, "Invalid value for %s: %s\n", argv[0], argv[1]);
+		result = -3;
+	}else if(argc > 2){
+		mc_printf(con, "Too many values for %s\n", argv[0]);
+		result = -3;
+	}
+
+	char value[MC_LOG_RECORD_SIZE], options[MC_LOG_RECORD_SIZE];
+	_mc_cvar_format(cvar, value, sizeof(value));
+	switch(cvar->type){
+		case MC_CVAR_INT:
+		case MC_CVAR_FLOAT:
+			snprintf(options, sizeof(options), "%g to %g", cvar->min, cvar->max);
+			break;
+		case MC_CVAR_BOOL:
+			snprintf(options, sizeof(options), "true or false");
+			break;
+		case MC_CVAR_STRING:
+			snprintf(options, sizeof(options), "up to %u bytes", cvar->size - 1);
+			break;
+		case MC_CVAR_ENUM:{
+			unsigned i, len = 0;
+			options[0] = '\0';
+			for(i = 0; i < cvar->size && len < sizeof(options); i++){
+				len += snprintf(options + len, sizeof(options) - len, i > 0 ? ", %s" : "%s", cvar->names[i]);
+			}
+			break;
+		}
+	}
+	mc_printf(con, "%s = %s (%s)\n", argv[0], value, options);
+
+	return result;
+}
+
+MC_API int mc_complete(struct mc_console *con, const char *prefix, int *cursor, const char **names, int max)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(prefix);
+	MC_ASSERT(cursor);
+
+	if(*cursor < 0){
+		return 0;
+	}
+
+	int root = _mc_trie_find(con, prefix, strlen(prefix));
+	if(root < 0){
+		*cursor = -1;
+		return 0;
+	}
+
+	int node = *cursor;
+	if(node == 0){
+		node = _mc_trie_first_cmd(con, root);
+	}
+
+	int n = 0;
+	while(node >= 0 && n < max){
+		names[n++] = con->cmdnames + con->cmds[con->trie[node].cmd].name;
+		node = _mc_trie_next_cmd(con, node, root);
+	}
+	*cursor = node;
+
+	return n;
+}
+
+// Split the command at the start of str into arguments in place and return where the next command starts.
+// Quotes and escapes are removed while copying the text back, so the write position never passes the read position.
+static char *_mc_tokenize(char *str, int *argc, char **argv)
+{
+	char *r = str, *w = str;
+	*argc = 0;
+	for(;;){
+		while(*r == ' ' || *r == '\t'){
+			r++;
+		}
+		if(*r == '\0'){
+			return r;
+		}
+		if(*r == ';'){
+			return r + 1;
+		}
+
+		// Arguments past MC_MAX_ARGS are still counted so the caller can report them
+		if(*argc < MC_MAX_ARGS){
+			argv[*argc] = w;
+		}
+		(*argc)++;
+
+		char quote = '\0';
+		for(; *r != '\0'; r++){
+			if(quote == '\0' && (*r == ' ' || *r == '\t' || *r == ';')){
+				break;
+			}
+			if(*r == quote){
+				quote = '\0';
+			}else if(quote == '\0' && (*r == '"' || *r == '\'')){
+				quote = *r;
+			}else if(*r == '\\' && quote != '\'' && r[1] != '\0'){
+				*w++ = *++r;
+			}else{
+				*w++ = *r;
+			}
+		}
+
+		char end = *r;
+		*w++ = '\0';
+		if(end == '\0'){
+			return r;
+		}
+		if(end == ';'){
+			return r + 1;
+		}
+		r++;
+	}
+}
+
+// Copy a line into the scratch buffer, returns NULL when it doesn't fit
+static char *_mc_exec_push(struct mc_console *con, const char *line, unsigned len)
+{
+	unsigned top = con->exectop;
+#ifdef MC_DYNAMIC_ARRAYS
+	if(top + len + 1 > con->execcap){
+		if(top > 0){
+			// Growing would move the arguments of the commands that are running
+			return NULL;
+		}
+		// Leave room for commands that call mc_execute, like MC_EXEC_BUFFER_SIZE does without dynamic arrays
+		unsigned cap = con->execcap * 2;
+		if(cap < 4 * (len + 1)){
+			cap = 4 * (len + 1);
+		}
+		char *execbuf = (char*)_mc_realloc(con, con->execbuf, cap);
+		if(!execbuf){
+			return NULL;
+		}
+		con->execbuf = execbuf;
+		con->execcap = cap;
+	}
+#else
+	if(top + len + 1 > MC_EXEC_BUFFER_SIZE){
+		return NULL;
+	}
+#endif
+
+	char *buf = con->execbuf + top;
+	memcpy(buf, line, len);
+	buf[len] = '\0';
+	con->exectop = top + len + 1;
+
+	return buf;
+}
+
+// Write like the commands print so everything shows up in the order it happened, in records small enough for the log queue
+static void _mc_exec_write(struct mc_console *con, const char *str, unsigned len)
+{
+	while(len > 0){
+		unsigned n = len < MC_LOG_RECORD_SIZE ? len : MC_LOG_RECORD_SIZE;
+		mc_write(con, str, n);
+		str += n;
+		len -= n;
+	}
+}
+
+static void _mc_exec_error(struct mc_console *con, const char *msg, const char *name)
+{
+	_mc_exec_write(con, msg, strlen(msg));
+	_mc_exec_write(con, name, strlen(name));
+	_mc_exec_write(con, "\n", 1);
+}
+
+#ifdef MC_MULTITHREADED
+// Queue an async command with a copy of its arguments, the scratch buffer is reused when this returns
+static int _mc_job_submit(struct mc_console *con, const struct mc_command *cmd, int argc, char **argv)
+{
+	if(con->nworkers == 0 && _mc_jobs_start(con)){
+		_mc_exec_error(con, "Could not start the workers for: ", argv[0]);
+		return -1;
+	}
+	if(con->jobfree < 0){
+		_mc_exec_error(con, "Busy, too many running commands for: ", argv[0]);
+		return -1;
+	}
+
+	struct mc_job *job = con->jobs + con->jobfree;
+	unsigned used = 0;
+	int i;
+	for(i = 0; i < argc; i++){
+		unsigned len = strlen(argv[i]) + 1;
+		if(used + len > MC_JOB_ARGS_SIZE){
+			_mc_exec_error(con, "Arguments too long: ", argv[0]);
+			return -1;
+		}
+		memcpy(job->args + used, argv[i], len);
+		job->argv[i] = job->args + used;
+		used += len;
+	}
+	job->argv[argc] = NULL;
+	job->argc = argc;
+	job->con = con;
+	job->func = cmd->async;
+	job->done = cmd->done;
+#ifdef MC_STATS
+	job->cmd = cmd - con->cmds;
+#endif
+	atomic_store(&job->cancelled, false);
+
+	int index = con->jobfree;
+	con->jobfree = job->next;
+	job->next = -1;
+
+	mtx_lock(&con->jobmutex);
+	if(con->jobqueuetail < 0){
+		con->jobqueue = index;
+	}else{
+		con->jobs[con->jobqueuetail].next = index;
+	}
+	con->jobqueuetail = index;
+	cnd_signal(&con->jobcond);
+	mtx_unlock(&con->jobmutex);
+
+	// The prompt shows that commands are running
+	con->njobs++;
+	con->indirty = true;
+
+	return 0;
+}
+
+MC_API int mc_cancel_jobs(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	if(!con->jobs){
+		return 0;
+	}
+
+	// Slots that are free get the flag reset when they're used again
+	int i;
+	for(i = 0; i < MC_MAX_JOBS; i++){
+		atomic_store(&con->jobs[i].cancelled, true);
+	}
+
+	return 0;
+}
+
+MC_API unsigned mc_pending_jobs(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	return con->njobs;
+}
+
+MC_API bool mc_job_cancelled(struct mc_job *job)
+{
+	MC_ASSERT(job);
+
+	return atomic_load_explicit(&job->cancelled, memory_order_relaxed);
+}
+#endif
+
+// Run the commands in buf and release it from the scratch buffer
+static int _mc_exec_run(struct mc_console *con, char *buf, unsigned top)
+{
+	int result = 0;
+	char *argv[MC_MAX_ARGS + 1];
+	while(*buf != '\0'){
+		int argc;
+		buf = _mc_tokenize(buf, &argc, argv);
+		if(argc == 0){
+			continue;
+		}
+		if(argc > MC_MAX_ARGS){
+			_mc_exec_error(con, "Too many arguments: ", argv[0]);
+			result = -2;
+			continue;
+		}
+		argv[argc] = NULL;
+
+		int index = _mc_find(con, argv[0], strlen(argv[0]));
+		if(index < 0){
+			_mc_exec_error(con, "Unknown command: ", argv[0]);
+			result = -2;
+			continue;
+		}
+#ifdef MC_MULTITHREADED
+		if(con->cmds[index].async){
+			if(_mc_job_submit(con, con->cmds + index, argc, argv)){
+				result = -4;
+			}
+			continue;
+		}
+#endif
+		if(con->cmds[index].cvar >= 0){
+			if(_mc_cvar_cmd(con, con->cvars + con->cmds[index].cvar, argc, argv)){
+				result = -3;
+			}
+			continue;
+		}
+		if(!con->cmds[index].func){
+			// Mapped to NULL, which counts as not registered
+			_mc_exec_error(con, "Unknown command: ", argv[0]);
+			result = -2;
+			continue;
+		}
+#ifdef MC_STATS
+		double start = MC_STATS_TIME();
+		con->cmds[index].func(con, argc, argv);
+		double time = MC_STATS_TIME() - start;
+		con->cmds[index].calls++;
+		con->cmds[index].time += time;
+		_MC_STAT(con, commands, 1);
+		_MC_STAT(con, commandtime, time);
+#else
+		con->cmds[index].func(con, argc, argv);
+#endif
+	}
+	con->exectop = top;
+
+	return result;
+}
+
+MC_API int mc_execute(struct mc_console *con, const char *line)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(line);
+
+	unsigned top = con->exectop;
+	char *buf = _mc_exec_push(con, line, strlen(line));
+	if(!buf){
+		return -1;
+	}
+
+	return _mc_exec_run(con, buf, top);
+}
+
+#define _MC_SPAN(con, span) ((con)->spans[(span) & (MC_MAX_COLOR_SPANS - 1)])
+
+// Colors at a span cursor, which is the first span after the position
+static void _mc_span_colors(const struct mc_console *con, unsigned span, unsigned char *fg, unsigned char *bg)
+{
+	if(span == con->spanfirst){
+		*fg = MC_DEFAULT_FG;
+		*bg = MC_DEFAULT_BG;
+		return;
+	}
+
+	*fg = _MC_SPAN(con, span - 1).fg;
+	*bg = _MC_SPAN(con, span - 1).bg;
+}
+
+// Span cursor of a position, positions wrap around so only their differences are compared
+static unsigned _mc_span_find(const struct mc_console *con, unsigned pos)
+{
+	unsigned first = con->spanfirst, n = con->spanend - con->spanfirst;
+	while(n > 0){
+		unsigned half = n / 2;
+		if((int)(_MC_SPAN(con, first + half).pos - pos) <= 0){
+			first += half + 1;
+			n -= half + 1;
+		}else{
+			n = half;
+		}
+	}
+
+	return first;
+}
+
+static unsigned _mc_span_advance(const struct mc_console *con, unsigned span, unsigned pos)
+{
+	while(span != con->spanend && (int)(_MC_SPAN(con, span).pos - pos) <= 0){
+		span++;
+	}
+
+	return span;
+}
+
+// Drop the spans of text that left the scrollback, the one the oldest line starts in is moved to its start
+static void _mc_span_trim(struct mc_console *con)
+{
+	unsigned start = _mc_ring_line_start(&con->out, con->out.first);
+	while(con->spanend - con->spanfirst > 1 && (int)(_MC_SPAN(con, con->spanfirst + 1).pos - start) <= 0){
+		con->spanfirst++;
+	}
+	if(con->spanend != con->spanfirst && (int)(_MC_SPAN(con, con->spanfirst).pos - start) < 0){
+		_MC_SPAN(con, con->spanfirst).pos = start;
+	}
+}
+
+// Output from pos on has the colors fg and bg, pos is never before the previous span
+static void _mc_span_set(struct mc_console *con, unsigned pos, unsigned char fg, unsigned char bg)
+{
+	if(con->spanend != con->spanfirst && _MC_SPAN(con, con->spanend - 1).pos == pos){
+		// Nothing was written in the previous colors
+		con->spanend--;
+	}
+
+	unsigned char curfg, curbg;
+	_mc_span_colors(con, con->spanend, &curfg, &curbg);
+	if(curfg == fg && curbg == bg){
+		return;
+	}
+
+	_mc_span_trim(con);
+	if(con->spanend - con->spanfirst == MC_MAX_COLOR_SPANS){
+		// The oldest text falls back to the default colors
+		con->spanfirst++;
+	}
+	_MC_SPAN(con, con->spanend) = (struct _mc_span){pos, fg, bg};
+	con->spanend++;
+}
+
+// 8 bit color nearest to a 24 bit color in the 6x6x6 cube, like xterm
+static unsigned char _mc_sgr_rgb(unsigned r, unsigned g, unsigned b)
+{
+	unsigned c[3] = {r, g, b}, i;
+	for(i = 0; i < 3; i++){
+		c[i] = c[i] < 48 ? 0 : c[i] < 115 ? 1 : c[i] > 255 ? 5 : (c[i] - 35) / 40;
+	}
+
+	return 16 + c[0] * 36 + c[1] * 6 + c[2];
+}
+
+// Apply the ';' separated parameters of a SGR sequence to the colors
+static void _mc_sgr_apply(struct _mc_sgr *sgr, const char *params, unsigned len)
+{
+	unsigned p[16], n = 1, i;
+	p[0] = 0;
+	for(i = 0; i < len; i++){
+		if(params[i] == ';'){
+			if(n == sizeof(p) / sizeof(p[0])){
+				break;
+			}
+			p[n++] = 0;
+		}else if(params[i] >= '0' && params[i] <= '9' && p[n - 1] < 1000){
+			p[n - 1] = p[n - 1] * 10 + params[i] - '0';
+		}
+	}
+
+	for(i = 0; i < n; i++){
+		unsigned v = p[i];
+		if(v == 0){
+			sgr->fg = MC_DEFAULT_FG;
+			sgr->bg = MC_DEFAULT_BG;
+		}else if(v >= 30 && v <= 37){
+			sgr->fg = v - 30;
+		}else if(v >= 90 && v <= 97){
+			sgr->fg = v - 90 + 8;
+		}else if(v >= 40 && v <= 47){
+			sgr->bg = v - 40;
+		}else if(v >= 100 && v <= 107){
+			sgr->bg = v - 100 + 8;
+		}else if(v == 39){
+			sgr->fg = MC_DEFAULT_FG;
+		}else if(v == 49){
+			sgr->bg = MC_DEFAULT_BG;
+		}else if(v == 38 || v == 48){
+			unsigned char c;
+			if(i + 2 < n && p[i + 1] == 5){
+				c = p[i + 2] & 255;
+				i += 2;
+			}else if(i + 4 < n && p[i + 1] == 2){
+				c = _mc_sgr_rgb(p[i + 2], p[i + 3], p[i + 4]);
+				i += 4;
+			}else{
+				break;
+			}
+			if(v == 38){
+				sgr->fg = c;
+			}else{
+				sgr->bg = c;
+			}
+		}
+	}
+}
+
+// Take the bytes of an escape sequence that starts at str, or continues when esclen isn't 0, and return how many it used.
+// SGR sequences change the colors from pos on, the others are dropped.
+static unsigned _mc_sgr_feed(struct mc_console *con, struct _mc_sgr *sgr, const char *str, unsigned len, unsigned pos)
+{
+	unsigned i = 0;
+	while(i < len){
+		char c = str[i++];
+		if(sgr->esclen == 0){
+			// The escape itself
+			sgr->esclen = 1;
+			continue;
+		}
+		if(sgr->esclen == 1 && c != '['){
+			// Two byte sequence
+			sgr->esclen = 0;
+			return i;
+		}
+		if(sgr->esclen > 1 && c >= 0x40 && c <= 0x7e){
+			if(c == 'm'){
+				_mc_sgr_apply(sgr, sgr->esc, sgr->esclen - 2);
+				_mc_span_set(con, pos, sgr->fg, sgr->bg);
+			}
+			sgr->esclen = 0;
+			return i;
+		}
+		if(sgr->esclen - 1 > sizeof(sgr->esc)){
+			// Too long to be a sequence, what follows is shown as text
+			sgr->esclen = 0;
+			return i;
+		}
+		if(sgr->esclen > 1){
+			sgr->esc[sgr->esclen - 2] = c;
+		}
+		sgr->esclen++;
+	}
+
+	return i;
+}
+
+// Append the output of a stream to the scrollback
+static void _mc_output_append(struct mc_console *con, struct _mc_sgr *sgr, const char *str, unsigned len)
+{
+	_mc_span_set(con, con->out.head, sgr->fg, sgr->bg);
+	while(len > 0){
+		unsigned n;
+		if(sgr->esclen > 0 || str[0] == 0x1b){
+			n = _mc_sgr_feed(con, sgr, str, len, con->out.head);
+		}else{
+			const char *esc = (const char*)memchr(str, 0x1b, len);
+			n = esc ? (unsigned)(esc - str) : len;
+			_mc_ring_write(&con->out, str, n);
+		}
+		str += n;
+		len -= n;
+	}
+}
+
+MC_API int mc_output_write(struct mc_console *con, const char *str, unsigned len)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(str || len == 0);
+
+	_mc_output_append(con, &con->outsgr, str, len);
+	con->outdirty = true;
+
+	return 0;
+}
+
+MC_API int mc_output_clear(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	// Start a new line without keeping any of the old ones so the line numbers keep increasing
+	con->out.first = con->out.end;
+	_mc_ring_new_line(&con->out);
+	con->outdirty = true;
+	con->outscrolled = false;
+
+	return 0;
+}
+
+MC_API unsigned mc_output_line_count(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	return con->out.end - con->out.first;
+}
+
+MC_API int mc_output_get_line(struct mc_console *con, unsigned n, char *buf, unsigned buflen)
+{
+	MC_ASSERT(con);
+
+	if(n >= con->out.end - con->out.first){
+		return -1;
+	}
+
+	unsigned line = con->out.first + n;
+	unsigned len = _mc_ring_line_len(&con->out, line);
+	if(buf && buflen > 0){
+		unsigned copy = len < buflen - 1 ? len : buflen - 1;
+		_mc_ring_copy(&con->out, _mc_ring_line_start(&con->out, line), buf, copy);
+		buf[copy] = '\0';
+	}
+
+	return len;
+}
+
+#ifdef MC_MULTITHREADED
+// Bounded multi producer single consumer queue, every record has a sequence number telling whose turn it is:
+// it equals the position when it's free for a producer and position + 1 when it holds a message for the consumer
+static struct mc_log_record *_mc_log_reserve(struct mc_console *con, unsigned *pos)
+{
+	unsigned p = atomic_load_explicit(&con->logenqueue, memory_order_relaxed);
+	for(;;){
+		struct mc_log_record *rec = con->logqueue + (p & (MC_LOG_QUEUE_SIZE - 1));
+		int diff = (int)(atomic_load_explicit(&rec->seq, memory_order_acquire) - p);
+		if(diff == 0){
+			if(atomic_compare_exchange_weak_explicit(&con->logenqueue, &p, p + 1, memory_order_relaxed, memory_order_relaxed)){
+				*pos = p;
+				break;
+			}
+		}else if(diff < 0){
+			atomic_fetch_add_explicit(&con->logdropped, 1, memory_order_relaxed);
+			return NULL;
+		}else{
+			p = atomic_load_explicit(&con->logenqueue, memory_order_relaxed);
+		}
+	}
+
+	// The consumer publishes its position once per mc_update so the depth can be overestimated
+	unsigned depth = *pos + 1 - atomic_load_explicit(&con->logdequeue, memory_order_relaxed);
+	if(depth > MC_LOG_QUEUE_SIZE){
+		depth = MC_LOG_QUEUE_SIZE;
+	}
+	unsigned high = atomic_load_explicit(&con->loghighwater, memory_order_relaxed);
+	while(depth > high && !atomic_compare_exchange_weak_explicit(&con->loghighwater, &high, depth, memory_order_relaxed, memory_order_relaxed));
+
+	return con->logqueue + (*pos & (MC_LOG_QUEUE_SIZE - 1));
+}
+
+static void _mc_log_publish(struct mc_log_record *rec, unsigned pos)
+{
+	atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+}
+#endif // MC_MULTITHREADED
+
+MC_API int mc_write(struct mc_console *con, const char *str, unsigned len)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(str || len == 0);
+
+#ifdef MC_MULTITHREADED
+	unsigned pos;
+	struct mc_log_record *rec = _mc_log_reserve(con, &pos);
+	if(!rec){
+		return -1;
+	}
+
+	rec->len = len < MC_LOG_RECORD_SIZE ? len : MC_LOG_RECORD_SIZE;
+	memcpy(rec->text, str, rec->len);
+	_mc_log_publish(rec, pos);
+
+	return 0;
+#else
+	return mc_output_write(con, str, len < MC_LOG_RECORD_SIZE ? len : MC_LOG_RECORD_SIZE);
+#endif
+}
+
+MC_API int mc_print(struct mc_console *con, const char *str)
+{
+	MC_ASSERT(str);
+
+	return mc_write(con, str, strlen(str));
+}
+
+static int _mc_vprintf(struct mc_console *con, const char *fmt, va_list args)
+{
+#ifdef MC_MULTITHREADED
+	// Format straight into the reserved record
+	unsigned pos;
+	struct mc_log_record *rec = _mc_log_reserve(con, &pos);
+	if(!rec){
+		return -1;
+	}
+
+	int len = vsnprintf(rec->text, MC_LOG_RECORD_SIZE + 1, fmt, args);
+	rec->len = len < 0 ? 0 : len < MC_LOG_RECORD_SIZE ? len : MC_LOG_RECORD_SIZE;
+	_mc_log_publish(rec, pos);
+#else
+	char text[MC_LOG_RECORD_SIZE + 1];
+	int len = vsnprintf(text, sizeof(text), fmt, args);
+	if(len > 0){
+		mc_output_write(con, text, len < MC_LOG_RECORD_SIZE ? len : MC_LOG_RECORD_SIZE);
+	}
+#endif
+
+	return len < 0 ? -2 : 0;
+}
+
+MC_API int mc_printf(struct mc_console *con, const char *fmt, ...)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(fmt);
+
+	va_list args;
+	va_start(args, fmt);
+	int result = _mc_vprintf(con, fmt, args);
+	va_end(args);
+
+	return result;
+}
+
+#ifdef MC_MULTITHREADED
+MC_API int mc_job_print(struct mc_job *job, const char *str)
+{
+	MC_ASSERT(job);
+
+	if(mc_job_cancelled(job)){
+		return -1;
+	}
+
+	return mc_print(job->con, str);
+}
+
+MC_API int mc_job_printf(struct mc_job *job, const char *fmt, ...)
+{
+	MC_ASSERT(job);
+	MC_ASSERT(fmt);
+
+	if(mc_job_cancelled(job)){
+		return -1;
+	}
+
+	va_list args;
+	va_start(args, fmt);
+	int result = _mc_vprintf(job->con, fmt, args);
+	va_end(args);
+
+	return result;
+}
+#endif
+
+#ifdef MC_ATTACH
+static int _mc_attach_slot(struct mc_console *con, int fd, bool file)
+{
+	int source;
+	for(source = 0; source < MC_MAX_ATTACHED; source++){
+		struct _mc_attached *a = con->attached + source;
+		if(a->fd < 0){
+			a->fd = fd;
+			a->file = a->ownsfd = file;
+			a->offset = a->mapoffset = 0;
+			a->map = NULL;
+			a->skipline = false;
+			a->partiallen = a->npartialspans = 0;
+			a->sgr = (struct _mc_sgr){MC_DEFAULT_FG, MC_DEFAULT_BG, {0}, 0};
+			return source;
+		}
+	}
+
+	return -3;
+}
+
+MC_API int mc_attach_fd(struct mc_console *con, int fd)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(fd >= 0);
+
+	int flags = fcntl(fd, F_GETFL);
+	if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0){
+		return -1;
+	}
+
+	return _mc_attach_slot(con, fd, false);
+}
+
+MC_API int mc_attach_file(struct mc_console *con, const char *path, bool fromend)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(path);
+
+	int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		return -1;
+	}
+	struct stat st;
+	if(fstat(fd, &st) < 0){
+		close(fd);
+		return -1;
+	}
+
+	int source = _mc_attach_slot(con, fd, true);
+	if(source < 0){
+		close(fd);
+		return source;
+	}
+	if(fromend){
+		con->attached[source].offset = st.st_size;
+	}
+
+	return source;
+}
+
+MC_API int mc_detach(struct mc_console *con, int source)
+{
+	MC_ASSERT(con);
+
+	if(source < 0 || source >= MC_MAX_ATTACHED || con->attached[source].fd < 0){
+		return -2;
+	}
+
+	struct _mc_attached *a = con->attached + source;
+	if(a->partiallen > 0){
+		unsigned base = con->out.head, i;
+		for(i = 0; i < a->npartialspans; i++){
+			_mc_span_set(con, base + a->partialspans[i].pos, a->partialspans[i].fg, a->partialspans[i].bg);
+		}
+		_mc_ring_put(&con->out, a->partial, a->partiallen);
+		con->outdirty = true;
+	}
+	if(a->map){
+		munmap(a->map, MC_ATTACH_WINDOW);
+	}
+	if(a->ownsfd){
+		close(a->fd);
+	}
+	a->fd = -1;
+
+	return 0;
+}
+
+// Take the escape sequences out of bytes read into the scrollback at base and return the length of the text that's left
+static unsigned _mc_attach_filter(struct mc_console *con, struct _mc_sgr *sgr, char *str, unsigned len, unsigned base)
+{
+	unsigned in = 0, out = 0;
+	while(in < len){
+		if(sgr->esclen > 0 || str[in] == 0x1b){
+			in += _mc_sgr_feed(con, sgr, str + in, len - in, base + out);
+			continue;
+		}
+		const char *esc = (const char*)memchr(str + in, 0x1b, len - in);
+		unsigned n = esc ? (unsigned)(esc - (str + in)) : len - in;
+		memmove(str + out, str + in, n);
+		in += n;
+		out += n;
+	}
+
+	return out;
+}
+
+// Read a pipe straight into the scrollback, the line that didn't end yet is taken out again until the rest arrives.
+// Returns the number of bytes read or -1 at the end of the stream.
+static int _mc_attach_read_fd(struct mc_console *con, struct _mc_attached *a, unsigned budget)
+{
+	struct mc_ring *ring = &con->out;
+	unsigned linestart = ring->head, total = 0, i;
+	for(i = 0; i < a->npartialspans; i++){
+		_mc_span_set(con, linestart + a->partialspans[i].pos, a->partialspans[i].fg, a->partialspans[i].bg);
+	}
+	_mc_ring_put(ring, a->partial, a->partiallen);
+	a->partiallen = a->npartialspans = 0;
+	_mc_span_set(con, ring->head, a->sgr.fg, a->sgr.bg);
+
+	int result = 0;
+	while(total < budget){
+		unsigned offset = ring->head & (ring->size - 1);
+		unsigned n = ring->size - offset < budget - total ? ring->size - offset : budget - total;
+		ssize_t len = read(a->fd, ring->data + offset, n);
+		if(len < 0 && errno == EINTR){
+			continue;
+		}
+		if(len <= 0){
+			if(len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)){
+				result = -1;
+			}
+			break;
+		}
+
+		// The bytes are already in place, only the lines they overwrote have to go
+		unsigned base = ring->head;
+		_mc_ring_reserve(ring, len);
+		char *chunk = ring->data + offset;
+		total += len;
+		if(a->sgr.esclen > 0 || memchr(chunk, 0x1b, len)){
+			len = _mc_attach_filter(con, &a->sgr, chunk, len, base);
+		}
+
+		const char *newline;
+		unsigned pos = 0;
+		while((newline = (const char*)memchr(chunk + pos, '\n', len - pos)) != NULL){
+			pos = newline - chunk + 1;
+			ring->head = base + pos;
+			_mc_ring_new_line(ring);
+			linestart = ring->head;
+		}
+		ring->head = base + len;
+	}
+
+	unsigned tail = ring->head - linestart;
+	if(tail <= MC_ATTACH_LINE_SIZE){
+		_mc_ring_copy(ring, linestart, a->partial, tail);
+		a->partiallen = tail;
+		ring->head = linestart;
+
+		// Keep the colors of the line with it, the start and the last changes in it
+		unsigned span = _mc_span_find(con, linestart);
+		struct _mc_span *keep = a->partialspans;
+		keep[0].pos = 0;
+		_mc_span_colors(con, span, &keep[0].fg, &keep[0].bg);
+		a->npartialspans = 1;
+		for(; span != con->spanend; span++){
+			unsigned n = a->npartialspans < sizeof(a->partialspans) / sizeof(a->partialspans[0]) ? a->npartialspans++ : a->npartialspans - 1;
+			keep[n] = _MC_SPAN(con, span);
+			keep[n].pos -= linestart;
+		}
+		con->spanend = _mc_span_find(con, linestart - 1);
+	}
+
+	return result < 0 ? result : (int)total;
+}
+
+// Copy the complete lines a file grew by from the mapped window into the scrollback.
+// Returns the number of bytes read or -1 when the file can't be read anymore.
+static int _mc_attach_read_file(struct mc_console *con, struct _mc_attached *a, unsigned budget)
+{
+	struct stat st;
+	if(fstat(a->fd, &st) < 0){
+		return -1;
+	}
+
+	off_t size = st.st_size;
+	if(size < a->offset){
+		// The file was truncated, follow it from the start again
+		a->offset = 0;
+		a->skipline = false;
+	}
+	if(size - a->offset > (off_t)con->out.size){
+		// What's before the last scrollback full would be dropped right away, skip it without reading
+		a->offset = size - con->out.size;
+		a->skipline = true;
+	}
+
+	unsigned total = 0;
+	while(total < budget && a->offset < size){
+		off_t mapend = a->mapoffset + MC_ATTACH_WINDOW;
+		if(!a->map || a->offset < a->mapoffset || (mapend < size && a->offset + MC_ATTACH_LINE_SIZE > mapend)){
+			// Move the window so a whole line fits after the offset
+			if(a->map){
+				munmap(a->map, MC_ATTACH_WINDOW);
+			}
+			long pagesize = sysconf(_SC_PAGESIZE);
+			MC_ASSERT(pagesize > 0 && MC_ATTACH_WINDOW % pagesize == 0 && MC_ATTACH_WINDOW - pagesize >= MC_ATTACH_LINE_SIZE);
+			a->mapoffset = a->offset - a->offset % pagesize;
+			a->map = (char*)mmap(NULL, MC_ATTACH_WINDOW, PROT_READ, MAP_SHARED, a->fd, a->mapoffset);
+			if(a->map == MAP_FAILED){
+				a->map = NULL;
+				return -1;
+			}
+			mapend = a->mapoffset + MC_ATTACH_WINDOW;
+		}
+
+		const char *data = a->map + (a->offset - a->mapoffset);
+		unsigned n = (unsigned)((mapend < size ? mapend : size) - a->offset);
+		if(n > budget - total){
+			n = budget - total;
+		}
+
+		if(a->skipline){
+			const char *newline = (const char*)memchr(data, '\n', n);
+			a->offset += newline ? newline - data + 1 : n;
+			a->skipline = !newline;
+			continue;
+		}
+
+		unsigned len = n;
+		while(len > 0 && data[len - 1] != '\n'){
+			len--;
+		}
+		if(len == 0){
+			if(n < MC_ATTACH_LINE_SIZE){
+				// Wait for the rest of the line
+				break;
+			}
+			len = n;
+		}
+
+		_mc_output_append(con, &a->sgr, data, len);
+		a->offset += len;
+		total += len;
+	}
+
+	return total;
+}
+
+// Read the attached sources until the bytes of this frame are used up, they take turns being first
+static void _mc_attach_poll(struct mc_console *con)
+{
+	unsigned budget = MC_ATTACH_FRAME_BYTES, i;
+	for(i = 0; i < MC_MAX_ATTACHED && budget > 0; i++){
+		int source = (con->attachnext + i) % MC_MAX_ATTACHED;
+		struct _mc_attached *a = con->attached + source;
+		if(a->fd < 0){
+			continue;
+		}
+
+		int len = a->file ? _mc_attach_read_file(con, a, budget) : _mc_attach_read_fd(con, a, budget);
+		if(len < 0){
+			mc_detach(con, source);
+			continue;
+		}
+		if(len > 0){
+			budget -= len;
+			con->outdirty = true;
+		}
+	}
+	con->attachnext = (con->attachnext + 1) % MC_MAX_ATTACHED;
+}
+#endif
+
+MC_API int mc_update(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+#ifdef MC_MULTITHREADED
+	// Take the finished jobs before the messages, so everything they printed is shown before they complete
+	int finished = -1;
+	if(con->njobs > 0){
+		mtx_lock(&con->jobmutex);
+		finished = con->jobfinished;
+		con->jobfinished = -1;
+		mtx_unlock(&con->jobmutex);
+	}
+
+	unsigned pos = con->logconsumed;
+	for(;;){
+		struct mc_log_record *rec = con->logqueue + (pos & (MC_LOG_QUEUE_SIZE - 1));
+		if((int)(atomic_load_explicit(&rec->seq, memory_order_acquire) - (pos + 1)) < 0){
+			break;
+		}
+
+		mc_output_write(con, rec->text, rec->len);
+		atomic_store_explicit(&rec->seq, pos + MC_LOG_QUEUE_SIZE, memory_order_release);
+		pos++;
+	}
+	con->logconsumed = pos;
+	atomic_store_explicit(&con->logdequeue, pos, memory_order_relaxed);
+
+	// The finished list is newest first, reverse it to complete the jobs in the order they finished
+	int order = -1;
+	while(finished >= 0){
+		int next = con->jobs[finished].next;
+		con->jobs[finished].next = order;
+		order = finished;
+		finished = next;
+	}
+	while(order >= 0){
+		struct mc_job *job = con->jobs + order;
+		int next = job->next;
+		if(job->done){
+			job->done(con, job->result);
+		}
+#ifdef MC_STATS
+		con->cmds[job->cmd].calls++;
+		con->cmds[job->cmd].time += job->time;
+		_MC_STAT(con, commands, 1);
+		_MC_STAT(con, commandtime, job->time);
+#endif
+		job->next = con->jobfree;
+		con->jobfree = order;
+		con->njobs--;
+		con->indirty = true;
+		order = next;
+	}
+#endif
+
+#ifdef MC_ATTACH
+	_mc_attach_poll(con);
+#endif
+
+#ifdef MC_STATS
+	struct mc_stat_counters *cur = &con->stats.current, *total = &con->stats.total;
+	total->glyphs += cur->glyphs;
+	total->pixels += cur->pixels;
+	total->uploadbytes += cur->uploadbytes;
+	total->dirtyarea += cur->dirtyarea;
+	total->commands += cur->commands;
+	total->commandtime += cur->commandtime;
+	con->stats.last = *cur;
+	memset(cur, 0, sizeof(struct mc_stat_counters));
+	con->stats.frames++;
+#endif
+
+	return 0;
+}
+
+MC_API int mc_get_log_stats(struct mc_console *con, unsigned *dropped, unsigned *highwater)
+{
+	MC_ASSERT(con);
+
+#ifdef MC_MULTITHREADED
+	if(dropped){
+		*dropped = atomic_load_explicit(&con->logdropped, memory_order_relaxed);
+	}
+	if(highwater){
+		*highwater = atomic_load_explicit(&con->loghighwater, memory_order_relaxed);
+	}
+#else
+	if(dropped){
+		*dropped = 0;
+	}
+	if(highwater){
+		*highwater = 0;
+	}
+#endif
+
+	return 0;
+}
+
+#ifdef MC_STATS
+MC_API int mc_get_stats(struct mc_console *con, struct mc_stats *stats)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(stats);
+
+	*stats = con->stats;
+	stats->scrollbackbytes = con->out.head - _mc_ring_line_start(&con->out, con->out.first);
+	stats->scrollbacklines = con->out.end - con->out.first;
+
+	return 0;
+}
+
+MC_API int mc_stats_add_upload(struct mc_console *con, unsigned long bytes)
+{
+	MC_ASSERT(con);
+
+	_MC_STAT(con, uploadbytes, bytes);
+
+	return 0;
+}
+
+static void _mc_stats_print_counters(struct mc_console *con, const char *name, const struct mc_stat_counters *c)
+{
+	mc_printf(con, "%s: %lu glyphs, %lu pixels, %lu upload bytes, %lu dirty pixels, %lu commands in %.3fms\n",
+			name, c->glyphs, c->pixels, c->uploadbytes, c->dirtyarea, c->commands, c->commandtime * 1000.0);
+}
+
+// The built-in "stats" command, prints the counters and the commands that took the most time
+static void _mc_stats_cmd(struct mc_console *con, int argc, char **argv)
+{
+	struct mc_stats stats;
+	mc_get_stats(con, &stats);
+
+	mc_printf(con, "%lu frames, %u scrollback lines in %u bytes\n", stats.frames, stats.scrollbacklines, stats.scrollbackbytes);
+	_mc_stats_print_counters(con, "last frame", &stats.last);
+	_mc_stats_print_counters(con, "total", &stats.total);
+
+	// Selection of the slowest commands, there are only a few to print
+	unsigned top[5], ntop = 0, i, j;
+	for(i = 0; i < con->ncmds; i++){
+		if(con->cmds[i].calls == 0){
+			continue;
+		}
+		for(j = ntop < 5 ? ntop++ : 5; j > 0 && con->cmds[top[j - 1]].time < con->cmds[i].time; j--){
+			if(j < 5){
+				top[j] = top[j - 1];
+			}
+		}
+		if(j < 5){
+			top[j] = i;
+		}
+	}
+	for(i = 0; i < ntop; i++){
+		const struct mc_command *cmd = con->cmds + top[i];
+		mc_printf(con, "%s: %lu calls in %.3fms\n", con->cmdnames + cmd->name, cmd->calls, cmd->time * 1000.0);
+	}
+}
+#endif
+
+#define _MC_UTF8_CONT(c) (((unsigned char)(c) & 0xc0) == 0x80)
+#define _MC_REPLACEMENT 0xfffd
+// Decoded codepoints that are shown, the C1 controls like U+009B, the 8 bit CSI, are controls as well
+#define _MC_IS_PRINTABLE_CODEPOINT(cp) ((cp) >= ' ' && ((cp) < 0x7f || (cp) > 0x9f))
+
+// Decode the character at the start of str, returns its length, 0 when str ends in the middle of it or -1 when it's invalid
+static int _mc_utf8_decode(const char *str, unsigned len, uint32_t *codepoint)
+{
+	const unsigned char *s = (const unsigned char*)str;
+	if(s[0] < 0x80){
+		*codepoint = s[0];
+		return 1;
+	}
+
+	// The allowed range of the second byte rules out overlong forms, surrogates and codepoints above U+10FFFF
+	unsigned char lo = 0x80, hi = 0xbf;
+	uint32_t cp;
+	unsigned n;
+	if(s[0] < 0xc2){
+		return -1;
+	}else if(s[0] < 0xe0){
+		n = 2;
+		cp = s[0] & 0x1f;
+	}else if(s[0] < 0xf0){
+		n = 3;
+		cp = s[0] & 0x0f;
+		if(s[0] == 0xe0){
+			lo = 0xa0;
+		}else if(s[0] == 0xed){
+			hi = 0x9f;
+		}
+	}else if(s[0] < 0xf5){
+		n = 4;
+		cp = s[0] & 0x07;
+		if(s[0] == 0xf0){
+			lo = 0x90;
+		}else if(s[0] == 0xf4){
+			hi = 0x8f;
+		}
+	}else{
+		return -1;
+	}
+
+	unsigned i;
+	for(i = 1; i < n; i++){
+		if(i >= len){
+			return 0;
+		}
+		if(s[i] < lo || s[i] > hi){
+			return -1;
+		}
+		cp = (cp << 6) | (s[i] & 0x3f);
+		lo = 0x80;
+		hi = 0xbf;
+	}
+	*codepoint = cp;
+
+	return n;
+}
+
+// Like _mc_utf8_decode but anything invalid is a single U+FFFD byte
+static unsigned _mc_utf8_next(const char *str, unsigned len, uint32_t *codepoint)
+{
+	int n = _mc_utf8_decode(str, len, codepoint);
+	if(n <= 0){
+		*codepoint = _MC_REPLACEMENT;
+		return 1;
+	}
+
+	return n;
+}
+
+// Write the codepoint to out and return the number of bytes, surrogates and invalid codepoints become U+FFFD
+static unsigned _mc_utf8_encode(uint32_t cp, char *out)
+{
+	if(cp < 0x80){
+		out[0] = cp;
+		return 1;
+	}
+	if(cp < 0x800){
+		out[0] = 0xc0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3f);
+		return 2;
+	}
+	if(cp >= 0x110000 || (cp >= 0xd800 && cp < 0xe000)){
+		cp = _MC_REPLACEMENT;
+	}
+	if(cp < 0x10000){
+		out[0] = 0xe0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3f);
+		out[2] = 0x80 | (cp & 0x3f);
+		return 3;
+	}
+	out[0] = 0xf0 | (cp >> 18);
+	out[1] = 0x80 | ((cp >> 12) & 0x3f);
+	out[2] = 0x80 | ((cp >> 6) & 0x3f);
+	out[3] = 0x80 | (cp & 0x3f);
+
+	return 4;
+}
+
+static unsigned _mc_input_len(const struct mc_console *con)
+{
+	return con->incap - (con->ingapend - con->ingap);
+}
+
+// Character at position pos of the text, skipping over the gap
+static char _mc_input_at(const struct mc_console *con, unsigned pos)
+{
+	return pos < con->ingap ? con->instr[pos] : con->instr[pos + con->ingapend - con->ingap];
+}
+
+// Move the gap to pos, only the text between the old and the new position is copied
+static void _mc_input_gap(struct mc_console *con, unsigned pos)
+{
+	if(pos < con->ingap){
+		unsigned n = con->ingap - pos;
+		memmove(con->instr + con->ingapend - n, con->instr + pos, n);
+		con->ingap -= n;
+		con->ingapend -= n;
+	}else if(pos > con->ingap){
+		unsigned n = pos - con->ingap;
+		memmove(con->instr + con->ingap, con->instr + con->ingapend, n);
+		con->ingap += n;
+		con->ingapend += n;
+	}
+}
+
+// Make the gap larger than len, so there's always room left for the null terminator of mc_input_get
+static int _mc_input_reserve(struct mc_console *con, unsigned len)
+{
+	if(con->ingapend - con->ingap > len){
+		return 0;
+	}
+
+#ifdef MC_DYNAMIC_ARRAYS
+	unsigned need = _mc_input_len(con) + len + 1;
+	unsigned cap = con->incap * 2;
+	if(cap < need){
+		cap = need;
+	}
+	char *instr = (char*)_mc_realloc(con, con->instr, cap);
+	if(!instr){
+		return -1;
+	}
+
+	// Move the text after the gap to the new end
+	unsigned after = con->incap - con->ingapend;
+	memmove(instr + cap - after, instr + con->ingapend, after);
+	con->instr = instr;
+	con->ingapend = cap - after;
+	con->incap = cap;
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+static int _mc_input_insert(struct mc_console *con, const char *str, unsigned len)
+{
+	if(len == 0){
+		return 0;
+	}
+
+	_mc_input_gap(con, con->inpos);
+	if(_mc_input_reserve(con, len)){
+		return -1;
+	}
+
+	memcpy(con->instr + con->ingap, str, len);
+	con->ingap += len;
+	con->inpos += len;
+	con->indirty = true;
+
+	return 0;
+}
+
+// Start of the character before pos and the end of the character at pos
+static unsigned _mc_input_prev(const struct mc_console *con, unsigned pos)
+{
+	while(pos > 0 && _MC_UTF8_CONT(_mc_input_at(con, --pos)));
+
+	return pos;
+}
+
+static unsigned _mc_input_next(const struct mc_console *con, unsigned pos)
+{
+	unsigned len = _mc_input_len(con);
+	if(pos < len){
+		pos++;
+	}
+	while(pos < len && _MC_UTF8_CONT(_mc_input_at(con, pos))){
+		pos++;
+	}
+
+	return pos;
+}
+
+static void _mc_input_delete(struct mc_console *con, unsigned start, unsigned end)
+{
+	if(start == end && con->inpos == start){
+		return;
+	}
+
+	_mc_input_gap(con, start);
+	con->ingapend += end - start;
+	con->inpos = start;
+	con->indirty = true;
+}
+
+// Start of the word before pos and the end of the word after pos, words are separated by spaces
+static unsigned _mc_input_word_start(const struct mc_console *con, unsigned pos)
+{
+	while(pos > 0 && _mc_input_at(con, pos - 1) == ' '){
+		pos--;
+	}
+	while(pos > 0 && _mc_input_at(con, pos - 1) != ' '){
+		pos--;
+	}
+
+	return pos;
+}
+
+static unsigned _mc_input_word_end(const struct mc_console *con, unsigned pos)
+{
+	unsigned len = _mc_input_len(con);
+	while(pos < len && _mc_input_at(con, pos) == ' '){
+		pos++;
+	}
+	while(pos < len && _mc_input_at(con, pos) != ' '){
+		pos++;
+	}
+
+	return pos;
+}
+
+// Cut the text from start to end into the kill buffer
+static int _mc_input_kill(struct mc_console *con, unsigned start, unsigned end)
+{
+	if(start == end){
+		return 0;
+	}
+
+	unsigned len = end - start;
+#ifdef MC_DYNAMIC_ARRAYS
+	if(len > con->killcap){
+		char *killbuf = (char*)_mc_realloc(con, con->killbuf, len);
+		if(!killbuf){
+			return -1;
+		}
+		con->killbuf = killbuf;
+		con->killcap = len;
+	}
+#endif
+
+	// With the gap at start the killed text is right behind it
+	_mc_input_gap(con, start);
+	memcpy(con->killbuf, con->instr + con->ingapend, len);
+	con->killlen = len;
+	_mc_input_delete(con, start, end);
+
+	return 0;
+}
+
+// Replace the input text from start to the cursor
+static int _mc_input_replace_word(struct mc_console *con, unsigned start, const char *str, unsigned len)
+{
+	// Reserve before deleting so a failed completion leaves the line as it was
+	unsigned removed = con->inpos - start;
+	_mc_input_gap(con, con->inpos);
+	if(_mc_input_reserve(con, len > removed ? len - removed : 0)){
+		return -1;
+	}
+
+	_mc_input_delete(con, start, con->inpos);
+	return _mc_input_insert(con, str, len);
+}
+
+MC_API const char *mc_input_get(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	unsigned len = _mc_input_len(con);
+	_mc_input_gap(con, len);
+	con->instr[len] = '\0';
+
+	return con->instr;
+}
+
+MC_API unsigned mc_input_length(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	return _mc_input_len(con);
+}
+
+static bool _mc_ring_equal(const struct mc_ring *ring, unsigned pos, const char *str, unsigned len)
+{
+	unsigned i;
+	for(i = 0; i < len; i++){
+		if(_mc_ring_char(ring, pos + i) != str[i]){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Replace the input line with len bytes of a ring starting at pos
+static void _mc_input_set_ring(struct mc_console *con, const struct mc_ring *ring, unsigned pos, unsigned len)
+{
+	con->inpos = con->ingap = 0;
+	con->ingapend = con->incap;
+	if(_mc_input_reserve(con, len)){
+		// Only the start fits
+		len = con->incap - 1;
+	}
+
+	_mc_ring_copy(ring, pos, con->instr, len);
+	con->inpos = con->ingap = len;
+	con->indirty = true;
+}
+
+static void _mc_history_show(struct mc_console *con, unsigned line)
+{
+	con->histpos = line;
+	_mc_input_set_ring(con, &con->hist, _mc_ring_line_start(&con->hist, line), _mc_ring_line_len(&con->hist, line));
+}
+
+// Keep the edited line in the last line of the history while browsing
+static void _mc_history_save_input(struct mc_console *con)
+{
+	struct mc_ring *hist = &con->hist;
+	unsigned len = _mc_input_len(con);
+	hist->head = _mc_ring_line_start(hist, hist->end - 1);
+	_mc_ring_put(hist, mc_input_get(con), len);
+}
+
+static int _mc_history_push(struct mc_console *con, const char *line, unsigned len)
+{
+	struct mc_ring *hist = &con->hist;
+
+	// Drop the edited line that was kept while browsing
+	hist->head = _mc_ring_line_start(hist, hist->end - 1);
+	con->histpos = hist->end - 1;
+
+	if(len == 0){
+		return 0;
+	}
+	if(hist->end - hist->first > 1){
+		unsigned last = hist->end - 2;
+		if(_mc_ring_line_len(hist, last) == len && _mc_ring_equal(hist, _mc_ring_line_start(hist, last), line, len)){
+			return 0;
+		}
+	}
+
+	_mc_ring_write(hist, line, len);
+	_mc_ring_write(hist, "\n", 1);
+	con->histpos = hist->end - 1;
+
+	return 0;
+}
+
+MC_API int mc_history_add(struct mc_console *con, const char *line)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(line);
+
+	return _mc_history_push(con, line, strlen(line));
+}
+
+MC_API unsigned mc_history_count(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	return con->hist.end - con->hist.first - 1;
+}
+
+MC_API int mc_history_get_line(struct mc_console *con, unsigned n, char *buf, unsigned buflen)
+{
+	MC_ASSERT(con);
+
+	if(n >= con->hist.end - con->hist.first - 1){
+		return -1;
+	}
+
+	unsigned line = con->hist.first + n;
+	unsigned len = _mc_ring_line_len(&con->hist, line);
+	if(buf && buflen > 0){
+		unsigned copy = len < buflen - 1 ? len : buflen - 1;
+		_mc_ring_copy(&con->hist, _mc_ring_line_start(&con->hist, line), buf, copy);
+		buf[copy] = '\0';
+	}
+
+	return len;
+}
+
+static int _mc_search_reserve(struct mc_console *con, unsigned n)
+{
+#ifdef MC_DYNAMIC_ARRAYS
+	if(n > con->searchcap){
+		unsigned cap = con->searchcap > 0 ? con->searchcap * 2 : 16;
+		struct mc_search_step *search = (struct mc_search_step*)_mc_realloc(con, con->search, cap * sizeof(struct mc_search_step));
+		if(!search){
+			return -1;
+		}
+		con->search = search;
+		con->searchcap = cap;
+	}
+#else
+	if(n > MC_MAX_INPUT_LENGTH){
+		return -1;
+	}
+#endif
+
+	return 0;
+}
+
+// Find the newest occurrence of the query in line that starts before limit, or in the lines before it.
+// The edited line is never searched.
+static bool _mc_search_find(struct mc_console *con, unsigned *line, unsigned *limit)
+{
+	const struct mc_ring *hist = &con->hist;
+	unsigned qlen = con->searchlen;
+	unsigned l = *line, lim = *limit;
+	if(l + 1 == hist->end){
+		if(l == hist->first){
+			return false;
+		}
+		l--;
+		lim = ~0u;
+	}
+
+	for(;;){
+		unsigned len = _mc_ring_line_len(hist, l);
+		if(len >= qlen){
+			unsigned start = _mc_ring_line_start(hist, l);
+			unsigned o = lim < len - qlen + 1 ? lim : len - qlen + 1;
+			while(o > 0){
+				o--;
+				unsigned i;
+				for(i = 0; i < qlen && _mc_ring_char(hist, start + o + i) == con->search[i + 1].c; i++);
+				if(i == qlen){
+					*line = l;
+					*limit = o;
+					return true;
+				}
+			}
+		}
+		if(l == hist->first){
+			return false;
+		}
+		l--;
+		lim = ~0u;
+	}
+}
+
+static void _mc_search_show(struct mc_console *con)
+{
+	const struct mc_search_step *step = con->search + con->searchlen;
+	_mc_history_show(con, step->line);
+	if(step->offset < con->inpos){
+		con->inpos = step->offset;
+	}
+}
+
+static int _mc_search_start(struct mc_console *con)
+{
+	if(_mc_search_reserve(con, 1)){
+		return -1;
+	}
+	if(con->histpos + 1 == con->hist.end){
+		_mc_history_save_input(con);
+	}
+
+	// The line that was shown is where the search starts and where it returns to when the query is erased
+	con->search[0] = (struct mc_search_step){con->histpos, con->inpos, '\0', true};
+	con->searchlen = 0;
+	con->searching = true;
+	con->indirty = true;
+
+	return 0;
+}
+
+static int _mc_search_next(struct mc_console *con)
+{
+	struct mc_search_step *step = con->search + con->searchlen;
+	unsigned line = step->line, offset = step->offset;
+	if(step->found && _mc_search_find(con, &line, &offset)){
+		step->line = line;
+		step->offset = offset;
+		_mc_search_show(con);
+	}
+
+	return 0;
+}
+
+// Every match of the longer query is also a match of the shorter one, so the search continues at the previous match
+static int _mc_search_push(struct mc_console *con, char c)
+{
+	if(_mc_search_reserve(con, con->searchlen + 2)){
+		return -1;
+	}
+
+	struct mc_search_step *step = con->search + con->searchlen + 1;
+	*step = step[-1];
+	step->c = c;
+	con->searchlen++;
+	con->indirty = true;
+
+	unsigned line = step->line, offset = step->offset + 1;
+	if(step->found && _mc_search_find(con, &line, &offset)){
+		step->line = line;
+		step->offset = offset;
+		_mc_search_show(con);
+	}else{
+		step->found = false;
+	}
+
+	return 0;
+}
+
+static int _mc_search_pop(struct mc_console *con)
+{
+	// A character is a step for every byte of it
+	while(con->searchlen > 0){
+		char c = con->search[con->searchlen--].c;
+		if(!_MC_UTF8_CONT(c)){
+			break;
+		}
+	}
+	_mc_search_show(con);
+
+	return 0;
+}
+
+static int _mc_input_complete(struct mc_console *con)
+{
+	// Only the command name, the first word, is completed, with the gap at the cursor it's in front of the gap
+	_mc_input_gap(con, con->inpos);
+	unsigned start = 0, i;
+	for(i = 0; i < con->inpos; i++){
+		if(con->instr[i] == ' '){
+			return 0;
+		}
+	}
+
+	if(con->compcur > 0){
+		// Cycle through the candidates after an ambiguous completion
+		int next = _mc_trie_next_cmd(con, con->compcur, con->comproot);
+		if(next < 0){
+			next = _mc_trie_first_cmd(con, con->comproot);
+		}
+		con->compcur = next;
+		const struct mc_command *cmd = con->cmds + con->trie[next].cmd;
+		return _mc_input_replace_word(con, start, con->cmdnames + cmd->name, cmd->namelen);
+	}
+
+	int node = _mc_trie_find(con, con->instr + start, con->inpos - start);
+	if(node < 0 || _mc_trie_first_cmd(con, node) < 0){
+		return 0;
+	}
+
+	// Follow the edges as long as there is only one way to go
+	while(!_mc_trie_is_cmd(con, node) && con->trie[node].child >= 0 && con->trie[con->trie[node].child].sibling < 0){
+		node = con->trie[node].child;
+	}
+
+	const struct mc_command *any = con->cmds + con->trie[node].any;
+	unsigned depth = con->trie[node].depth;
+	if(depth > con->inpos - start){
+		if(_mc_input_replace_word(con, start, con->cmdnames + any->name, depth)){
+			return -1;
+		}
+		if(con->trie[node].child < 0){
+			return _mc_input_replace_word(con, con->inpos, " ", 1);
+		}
+		return 0;
+	}
+
+	if(con->trie[node].child >= 0){
+		con->comproot = node;
+		con->compcur = _mc_trie_first_cmd(con, node);
+		const struct mc_command *cmd = con->cmds + con->trie[con->compcur].cmd;
+		return _mc_input_replace_word(con, start, con->cmdnames + cmd->name, cmd->namelen);
+	}
+
+	return 0;
+}
+
+// Bytes above 0x7f are part of a UTF-8 character
+#define _MC_IS_PRINTABLE(c) ((c) >= ' ' && (c) != 0x7f)
+
+static int _mc_input_key(struct mc_console *con, enum mc_keys key)
+{
+	con->compcur = 0;
+	con->inpendlen = 0;
+
+	if(con->searching){
+		if(key == MC_KEY_SEARCH){
+			return _mc_search_next(con);
+		}
+		if(key == MC_KEY_BACKSPACE){
+			return _mc_search_pop(con);
+		}
+		if(key == MC_KEY_CANCEL){
+			// Go back to where the search started
+			con->searchlen = 0;
+			_mc_search_show(con);
+			con->searching = false;
+			return 0;
+		}
+		// Any other key takes the match and is handled as usual
+		con->searching = false;
+		con->indirty = true;
+	}
+
+	unsigned len = _mc_input_len(con), pos = con->inpos;
+	switch(key){
+		case MC_KEY_LEFT:
+			con->inpos = _mc_input_prev(con, con->inpos);
+			break;
+		case MC_KEY_RIGHT:
+			con->inpos = _mc_input_next(con, con->inpos);
+			break;
+		case MC_KEY_UP:
+			if(con->histpos != con->hist.first){
+				if(con->histpos + 1 == con->hist.end){
+					_mc_history_save_input(con);
+				}
+				_mc_history_show(con, con->histpos - 1);
+			}
+			break;
+		case MC_KEY_DOWN:
+			if(con->histpos + 1 != con->hist.end){
+				_mc_history_show(con, con->histpos + 1);
+			}
+			break;
+		case MC_KEY_BACKSPACE:
+			_mc_input_delete(con, _mc_input_prev(con, con->inpos), con->inpos);
+			break;
+		case MC_KEY_DELETE:
+			_mc_input_delete(con, con->inpos, _mc_input_next(con, con->inpos));
+			break;
+		case MC_KEY_HOME:
+			con->inpos = 0;
+			break;
+		case MC_KEY_END:
+			con->inpos = len;
+			break;
+		case MC_KEY_INSERT:
+			con->insert = !con->insert;
+			break;
+		case MC_KEY_WORD_LEFT:
+			con->inpos = _mc_input_word_start(con, con->inpos);
+			break;
+		case MC_KEY_WORD_RIGHT:
+			con->inpos = _mc_input_word_end(con, con->inpos);
+			break;
+		case MC_KEY_KILL_END:
+			return _mc_input_kill(con, con->inpos, len);
+		case MC_KEY_KILL_WORD:
+			return _mc_input_kill(con, _mc_input_word_start(con, con->inpos), con->inpos);
+		case MC_KEY_KILL_START:
+			return _mc_input_kill(con, 0, con->inpos);
+		case MC_KEY_YANK:
+			return _mc_input_insert(con, con->killbuf, con->killlen);
+		case MC_KEY_SEARCH:
+			return _mc_search_start(con);
+		case MC_KEY_CANCEL:
+#ifdef MC_MULTITHREADED
+			if(con->njobs > 0){
+				_mc_exec_write(con, "Cancelled\n", 10);
+				return mc_cancel_jobs(con);
+			}
+#endif
+			_mc_input_delete(con, 0, len);
+			break;
+		case MC_KEY_PAGE_UP:
+			return mc_output_scroll(con, con->outheight > 2 ? con->outheight - 2 : 1);
+		case MC_KEY_PAGE_DOWN:
+			return mc_output_scroll(con, con->outheight > 2 ? 2 - (int)con->outheight : -1);
+	}
+	if(con->inpos != pos){
+		con->indirty = true;
+	}
+
+	return 0;
+}
+
+// Echo the line, add it to the history and run it with an empty input line
+static int _mc_input_enter(struct mc_console *con)
+{
+	unsigned len = _mc_input_len(con);
+	const char *line = mc_input_get(con);
+	// Show the end of the output again to see what the command prints
+	con->outscrolled = false;
+	_mc_exec_write(con, MC_PROMPT, sizeof(MC_PROMPT) - 1);
+	_mc_exec_write(con, line, len);
+	_mc_exec_write(con, "\n", 1);
+	_mc_history_push(con, line, len);
+
+	unsigned top = con->exectop;
+	char *buf = _mc_exec_push(con, line, len);
+	con->inpos = con->ingap = 0;
+	con->ingapend = con->incap;
+	con->indirty = true;
+	if(!buf){
+		return -1;
+	}
+
+	// Unknown commands are reported in the output
+	_mc_exec_run(con, buf, top);
+
+	return 0;
+}
+
+// Type valid UTF-8 at the cursor or into the search
+static int _mc_input_put(struct mc_console *con, const char *str, unsigned len)
+{
+	if(con->searching){
+		unsigned i;
+		for(i = 0; i < len; i++){
+			if(_mc_search_push(con, str[i])){
+				return -1;
+			}
+		}
+		return 0;
+	}
+
+	if(!con->insert){
+		// Overwrite as many characters as are typed
+		unsigned end = con->inpos, i;
+		for(i = 0; i < len; i++){
+			if(!_MC_UTF8_CONT(str[i])){
+				end = _mc_input_next(con, end);
+			}
+		}
+		_mc_input_delete(con, con->inpos, end);
+	}
+
+	int result = 0;
+#ifndef MC_DYNAMIC_ARRAYS
+	// What doesn't fit is dropped, without splitting a character
+	unsigned room = con->incap - 1 - _mc_input_len(con);
+	if(len > room){
+		for(len = room; len > 0 && _MC_UTF8_CONT(str[len]); len--);
+		result = -1;
+	}
+#endif
+	if(_mc_input_insert(con, str, len)){
+		return -1;
+	}
+
+	return result;
+}
+
+// Type a run of printable bytes, invalid UTF-8 is typed as U+FFFD and a character that's cut off at the end waits in inpend for the rest
+static int _mc_input_type(struct mc_console *con, const char *str, unsigned len)
+{
+	con->compcur = 0;
+
+	unsigned i;
+	if(con->inpendlen == 0){
+		for(i = 0; i < len && (unsigned char)str[i] < 0x80; i++);
+		if(i == len){
+			return _mc_input_put(con, str, len);
+		}
+	}
+
+	char buf[64];
+	unsigned n = 0;
+	int result = 0;
+	i = 0;
+	while(i < len){
+		uint32_t cp;
+		if(con->inpendlen > 0){
+			con->inpend[con->inpendlen++] = str[i++];
+			int r = _mc_utf8_decode(con->inpend, con->inpendlen, &cp);
+			if(r == 0){
+				continue;
+			}
+			if(r > 0 && _MC_IS_PRINTABLE_CODEPOINT(cp)){
+				memcpy(buf + n, con->inpend, r);
+				n += r;
+			}else if(r > 0){
+				n += _mc_utf8_encode(_MC_REPLACEMENT, buf + n);
+			}else{
+				// The byte that broke the character can start the next one
+				n += _mc_utf8_encode(_MC_REPLACEMENT, buf + n);
+				i--;
+			}
+			con->inpendlen = 0;
+		}else{
+			int r = _mc_utf8_decode(str + i, len - i, &cp);
+			if(r == 0){
+				memcpy(con->inpend, str + i, len - i);
+				con->inpendlen = len - i;
+				break;
+			}
+			if(r > 0 && _MC_IS_PRINTABLE_CODEPOINT(cp)){
+				memcpy(buf + n, str + i, r);
+				n += r;
+				i += r;
+			}else if(r > 0){
+				n += _mc_utf8_encode(_MC_REPLACEMENT, buf + n);
+				i += r;
+			}else{
+				n += _mc_utf8_encode(_MC_REPLACEMENT, buf + n);
+				i++;
+			}
+		}
+
+		if(n + 4 > sizeof(buf)){
+			if(_mc_input_put(con, buf, n)){
+				result = -1;
+			}
+			n = 0;
+		}
+	}
+	if(n > 0 && _mc_input_put(con, buf, n)){
+		result = -1;
+	}
+
+	return result;
+}
+
+static int _mc_input_char(struct mc_console *con, char key)
+{
+	if(_MC_IS_PRINTABLE((unsigned char)key)){
+		return _mc_input_type(con, &key, 1);
+	}
+
+	if(key != '\t'){
+		con->compcur = 0;
+	}
+	if(con->searching){
+		con->searching = false;
+		con->indirty = true;
+	}
+	con->inpendlen = 0;
+
+	switch(key){
+		case '\n':
+		case '\r':
+			return _mc_input_enter(con);
+		case '\t':
+			return _mc_input_complete(con);
+	}
+
+	return 0;
+}
+
+MC_API int mc_input_key(struct mc_console *con, enum mc_keys key)
+{
+	MC_ASSERT(con);
+
+	return _mc_input_key(con, key);
+}
+
+MC_API int mc_input_char(struct mc_console *con, char key)
+{
+	MC_ASSERT(con);
+	if(key == '\0'){
+		return -1;
+	}
+
+	return _mc_input_char(con, key);
+}
+
+MC_API int mc_input_codepoint(struct mc_console *con, uint32_t codepoint)
+{
+	MC_ASSERT(con);
+	if(codepoint == 0){
+		return -1;
+	}
+
+	if(_MC_IS_PRINTABLE_CODEPOINT(codepoint)){
+		char buf[4];
+		return _mc_input_type(con, buf, _mc_utf8_encode(codepoint, buf));
+	}
+	if(codepoint >= 0x80){
+		// C1 controls don't do anything
+		return 0;
+	}
+
+	return _mc_input_char(con, codepoint);
+}
+
+MC_API int mc_input_batch(struct mc_console *con, const struct mc_input_event *events, unsigned n)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(events || n == 0);
+
+	int result = 0;
+	unsigned i = 0;
+	while(i < n){
+		if(events[i].c == 0){
+			if(_mc_input_key(con, events[i].key)){
+				result = -1;
+			}
+			i++;
+			continue;
+		}
+
+		char run[64];
+		unsigned len = 0;
+		while(i < n && len + 4 <= sizeof(run) && _MC_IS_PRINTABLE_CODEPOINT(events[i].c)){
+			len += _mc_utf8_encode(events[i++].c, run + len);
+		}
+		if(len > 0){
+			if(_mc_input_type(con, run, len)){
+				result = -1;
+			}
+		}else if(events[i].c >= 0x80){
+			i++;
+		}else{
+			if(_mc_input_char(con, events[i++].c)){
+				result = -1;
+			}
+		}
+	}
+
+	return result;
+}
+
+MC_API int mc_input_text(struct mc_console *con, const char *str, unsigned len)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(str || len == 0);
+
+	int result = 0;
+	unsigned i = 0;
+	while(i < len){
+		unsigned start = i;
+		while(i < len && _MC_IS_PRINTABLE((unsigned char)str[i])){
+			i++;
+		}
+		if(i > start){
+			if(_mc_input_type(con, str + start, i - start)){
+				result = -1;
+			}
+			continue;
+		}
+
+		// A "\r\n" line end runs the line once
+		if(str[i] == '\r' && i + 1 < len && str[i + 1] == '\n'){
+			i++;
+		}
+		if(str[i] != '\0'){
+			if(_mc_input_char(con, str[i])){
+				result = -1;
+			}
+		}
+		i++;
+	}
+
+	return result;
+}
+
+#ifdef MC_OUTPUT_TEXTURE
+#if defined MC_OUTPUT_TEXTURE_RGBA || defined MC_OUTPUT_TEXTURE_BGRA
+#define _MC_PIXEL(r_, g_, b_, a_) ((struct mc_pixel){.r = (r_), .g = (g_), .b = (b_), .a = (a_)})
+#elif !defined MC_OUTPUT_TEXTURE_INDEXED8
+#define _MC_PIXEL(r_, g_, b_, a_) ((struct mc_pixel){.r = (r_), .g = (g_), .b = (b_)})
+#endif
+
+// Pixel of a palette entry, indexed textures store the index itself
+static struct mc_pixel _mc_palette_pixel(const struct mc_console *con, unsigned char index)
+{
+#ifdef MC_OUTPUT_TEXTURE_INDEXED8
+	return (struct mc_pixel){index};
+#else
+	return con->palettepixels[index];
+#endif
+}
+
+static void _mc_cell_pixels(const struct mc_console *con, struct mc_cell cell, struct mc_pixel *fg, struct mc_pixel *bg)
+{
+	*fg = _mc_palette_pixel(con, cell.fg);
+	*bg = _mc_palette_pixel(con, cell.bg);
+	if(cell.attr & MC_ATTR_INVERSE){
+		struct mc_pixel swap = *fg;
+		*fg = *bg;
+		*bg = swap;
+	}
+}
+
+#if !defined MC_NO_SIMD && defined __AVX2__
+#define _MC_SIMD_AVX2
+#define _MC_SIMD_SSE2
+#include <immintrin.h>
+#elif !defined MC_NO_SIMD && (defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2))
+#define _MC_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+// The widest row is 32 pixels of 4 bytes
+#define _MC_BLIT_MAX_BYTES (32 * 4)
+
+// For every byte of an expanded row: which byte of the row mask it reads and which bit in that byte
+#define _MC_BLIT_BYTESEL(i) (((i) / sizeof(struct mc_pixel)) >> 3)
+#define _MC_BLIT_BITSEL(i) (1 << (((i) / sizeof(struct mc_pixel)) & 7))
+#define _MC_BLIT_REP8(f, i) f(i), f(i + 1), f(i + 2), f(i + 3), f(i + 4), f(i + 5), f(i + 6), f(i + 7)
+#define _MC_BLIT_REP32(f, i) _MC_BLIT_REP8(f, i), _MC_BLIT_REP8(f, i + 8), _MC_BLIT_REP8(f, i + 16), _MC_BLIT_REP8(f, i + 24)
+static const unsigned char _mc_blit_bytesel[_MC_BLIT_MAX_BYTES] = {
+	_MC_BLIT_REP32(_MC_BLIT_BYTESEL, 0), _MC_BLIT_REP32(_MC_BLIT_BYTESEL, 32), _MC_BLIT_REP32(_MC_BLIT_BYTESEL, 64), _MC_BLIT_REP32(_MC_BLIT_BYTESEL, 96)
+};
+static const unsigned char _mc_blit_bitsel[_MC_BLIT_MAX_BYTES] = {
+	_MC_BLIT_REP32(_MC_BLIT_BITSEL, 0), _MC_BLIT_REP32(_MC_BLIT_BITSEL, 32), _MC_BLIT_REP32(_MC_BLIT_BITSEL, 64), _MC_BLIT_REP32(_MC_BLIT_BITSEL, 96)
+};
+
+struct _mc_blit_colors {
+	unsigned char fg[_MC_BLIT_MAX_BYTES], bg[_MC_BLIT_MAX_BYTES];
+};
+
+static void _mc_blit_colors_set(struct _mc_blit_colors *col, int width, struct mc_pixel fg, struct mc_pixel bg)
+{
+	struct mc_pixel *f = (struct mc_pixel*)col->fg, *b = (struct mc_pixel*)col->bg;
+	int i;
+	for(i = 0; i < width; i++){
+		f[i] = fg;
+		b[i] = bg;
+	}
+}
+
+static void _mc_blit_row_scalar(struct mc_pixel *dst, uint32_t mask, int width, const struct _mc_blit_colors *col)
+{
+	const struct mc_pixel *fg = (const struct mc_pixel*)col->fg, *bg = (const struct mc_pixel*)col->bg;
+	int i;
+	for(i = 0; i < width; i++){
+		dst[i] = ((mask >> i) & 1) ? fg[i] : bg[i];
+	}
+}
+
+#ifdef _MC_SIMD_SSE2
+static __m128i _mc_blit_expand_sse2(uint32_t mask, const struct _mc_blit_colors *col, int offset)
+{
+	// A run of 16 bytes never covers more than 6 pixels, so it reads from at most two mask bytes
+	int first = _mc_blit_bytesel[offset];
+	__m128i lo = _mm_set1_epi8((char)(mask >> (first << 3)));
+	__m128i hi = _mm_set1_epi8((char)((uint64_t)mask >> ((first + 1) << 3)));
+	__m128i sel = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(_mc_blit_bytesel + offset)), _mm_set1_epi8((char)first));
+	__m128i bytes = _mm_or_si128(_mm_and_si128(sel, lo), _mm_andnot_si128(sel, hi));
+
+	__m128i bit = _mm_loadu_si128((const __m128i*)(_mc_blit_bitsel + offset));
+	__m128i set = _mm_cmpeq_epi8(_mm_and_si128(bytes, bit), bit);
+
+	__m128i fg = _mm_loadu_si128((const __m128i*)(col->fg + offset));
+	__m128i bg = _mm_loadu_si128((const __m128i*)(col->bg + offset));
+	return _mm_or_si128(_mm_and_si128(set, fg), _mm_andnot_si128(set, bg));
+}
+
+static void _mc_blit_row_sse2(struct mc_pixel *dst, uint32_t mask, int width, const struct _mc_blit_colors *col)
+{
+	unsigned char *out = (unsigned char*)dst;
+	int len = width * (int)sizeof(struct mc_pixel);
+	if(len < 16){
+		_mc_blit_row_scalar(dst, mask, width, col);
+		return;
+	}
+
+	int i;
+	for(i = 0; i + 16 <= len; i += 16){
+		_mm_storeu_si128((__m128i*)(out + i), _mc_blit_expand_sse2(mask, col, i));
+	}
+	if(i < len && sizeof(struct mc_pixel) == 1){
+		// An unaligned run of 16 single byte pixels can read from three mask bytes
+		_mc_blit_row_scalar(dst + i, mask >> i, len - i, col);
+	}else if(i < len){
+		// Finish with a store that overlaps the previous one instead of writing past the row
+		_mm_storeu_si128((__m128i*)(out + len - 16), _mc_blit_expand_sse2(mask, col, len - 16));
+	}
+}
+#endif // _MC_SIMD_SSE2
+
+#ifdef _MC_SIMD_AVX2
+static void _mc_blit_row_avx2(struct mc_pixel *dst, uint32_t mask, int width, const struct _mc_blit_colors *col)
+{
+	unsigned char *out = (unsigned char*)dst;
+	int len = width * (int)sizeof(struct mc_pixel);
+	if(len < 32){
+		_mc_blit_row_sse2(dst, mask, width, col);
+		return;
+	}
+
+	// Every 128 bit lane holds the full mask, so the in-lane shuffle can pick any of its bytes
+	__m256i all = _mm256_set1_epi32((int)mask);
+
+	int i = 0;
+	while(i < len){
+		if(i + 32 > len){
+			i = len - 32;
+		}
+
+		__m256i bytes = _mm256_shuffle_epi8(all, _mm256_loadu_si256((const __m256i*)(_mc_blit_bytesel + i)));
+		__m256i bit = _mm256_loadu_si256((const __m256i*)(_mc_blit_bitsel + i));
+		__m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bit), bit);
+
+		__m256i fg = _mm256_loadu_si256((const __m256i*)(col->fg + i));
+		__m256i bg = _mm256_loadu_si256((const __m256i*)(col->bg + i));
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_blendv_epi8(bg, fg, set));
+
+		i += 32;
+	}
+}
+#endif // _MC_SIMD_AVX2
+
+static void _mc_blit_row(struct mc_pixel *dst, uint32_t mask, int width, const struct _mc_blit_colors *col)
+{
+#ifdef _MC_SIMD_AVX2
+	_mc_blit_row_avx2(dst, mask, width, col);
+#elif defined _MC_SIMD_SSE2
+	_mc_blit_row_sse2(dst, mask, width, col);
+#else
+	_mc_blit_row_scalar(dst, mask, width, col);
+#endif
+}
+
+// ASCII shown for U+00C0 to U+00FF and other common characters a font doesn't have
+static const char _mc_font_latin1_fallback[] = "AAAAAAACEEEEIIIIDNOOOOOxOUUUUYPsaaaaaaaceeeeiiiidnooooo/ouuuuypy";
+static const struct {
+	uint32_t codepoint;
+	char c;
+} _mc_font_fallback[] = {
+	{0x00a0, ' '}, {0x00ab, '<'}, {0x00bb, '>'}, {0x2010, '-'}, {0x2011, '-'}, {0x2012, '-'}, {0x2013, '-'}, {0x2014, '-'},
+	{0x2018, '\''}, {0x2019, '\''}, {0x201c, '"'}, {0x201d, '"'}, {0x2022, '*'}, {0x2039, '<'}, {0x203a, '>'}, {0x2212, '-'}
+};
+
+// Glyph of the codepoint or -1 when the font doesn't have it, which is only possible for ASCII
+static int _mc_font_glyph(const struct mc_font *font, uint32_t codepoint)
+{
+	int c = -1;
+	if((codepoint >> 8) < font->npagemap){
+		c = font->pages[font->pagemap[codepoint >> 8] * 256 + (codepoint & 255)];
+	}
+
+	return c >= 0 || codepoint < 0x80 ? c : font->replacement;
+}
+
+// Glyph of the codepoint in a font with the glyphs from start to start + num
+static int _mc_font_range_glyph(unsigned start, unsigned num, uint32_t codepoint)
+{
+	return codepoint >= start && codepoint - start < num ? (int)(codepoint - start) : -1;
+}
+
+MC_API struct mc_font *mc_font_load(const void *data, size_t size)
+{
+	MC_ASSERT(data);
+
+	const unsigned char *bin = (const unsigned char*)data;
+	if(size < 13 || bin[0] != 1){
+		return NULL;
+	}
+
+	unsigned glyphwidth = bin[1], glyphheight = bin[2], start = bin[3], num = bin[4];
+	unsigned width = ((unsigned)bin[5] << 24) | (bin[6] << 16) | (bin[7] << 8) | bin[8];
+	unsigned totallen = ((unsigned)bin[9] << 24) | (bin[10] << 16) | (bin[11] << 8) | bin[12];
+
+	// A row has to fit in a single mask
+	if(glyphwidth == 0 || glyphwidth > 32 || glyphheight == 0 || num == 0 || width < num * glyphwidth){
+		return NULL;
+	}
+	// The sizes come from the file, so they are checked without wrapping around
+	uint64_t nbits = (uint64_t)width * glyphheight, lastbit = (uint64_t)(glyphheight - 1) * width + num * glyphwidth;
+	if(nbits > UINT32_MAX || totallen < nbits || (uint64_t)(size - 13) < (nbits + 7) / 8 || lastbit > (uint64_t)(size - 13) * 8){
+		return NULL;
+	}
+
+	// Every codepoint with a glyph, the font's own and the fallbacks to them
+	struct {
+		uint32_t codepoint;
+		int glyph;
+	} map[256 + sizeof(_mc_font_latin1_fallback) + sizeof(_mc_font_fallback) / sizeof(_mc_font_fallback[0])];
+	unsigned nmap = 0, i;
+	for(i = 0; i < num; i++){
+		map[nmap].codepoint = start + i;
+		map[nmap++].glyph = i;
+	}
+	for(i = 0; i < sizeof(_mc_font_latin1_fallback) - 1; i++){
+		int glyph = _mc_font_range_glyph(start, num, _mc_font_latin1_fallback[i]);
+		if(glyph >= 0 && _mc_font_range_glyph(start, num, 0xc0 + i) < 0){
+			map[nmap].codepoint = 0xc0 + i;
+			map[nmap++].glyph = glyph;
+		}
+	}
+	for(i = 0; i < sizeof(_mc_font_fallback) / sizeof(_mc_font_fallback[0]); i++){
+		int glyph = _mc_font_range_glyph(start, num, _mc_font_fallback[i].c);
+		if(glyph >= 0 && _mc_font_range_glyph(start, num, _mc_font_fallback[i].codepoint) < 0){
+			map[nmap].codepoint = _mc_font_fallback[i].codepoint;
+			map[nmap++].glyph = glyph;
+		}
+	}
+
+	// Page 0 is the empty page
+	uint16_t pagemap[0x110000 >> 8];
+	memset(pagemap, 0, sizeof(pagemap));
+	unsigned npages = 1, npagemap = 0;
+	for(i = 0; i < nmap; i++){
+		unsigned page = map[i].codepoint >> 8;
+		if(pagemap[page] == 0){
+			pagemap[page] = npages++;
+		}
+		if(page >= npagemap){
+			npagemap = page + 1;
+		}
+	}
+
+	// Everything is in one block after the font
+	size_t rowsize = num * glyphheight * sizeof(uint32_t), pagesize = npages * 256 * sizeof(int16_t);
+	struct mc_font *font = (struct mc_font*)MC_MALLOC(sizeof(struct mc_font) + rowsize + pagesize + npagemap * sizeof(uint16_t));
+	if(!font){
+		return NULL;
+	}
+	uint32_t *rows = (uint32_t*)(font + 1);
+	int16_t *pages = (int16_t*)((char*)rows + rowsize);
+	uint16_t *fontpagemap = (uint16_t*)((char*)pages + pagesize);
+
+	// The ccFont bitmap is a single row major image with the glyphs next to each other
+	const unsigned char *bits = bin + 13;
+	for(i = 0; i < num; i++){
+		unsigned y;
+		for(y = 0; y < glyphheight; y++){
+			uint64_t first = (uint64_t)y * width + i * glyphwidth;
+			uint32_t mask = 0;
+			unsigned x;
+			for(x = 0; x < glyphwidth; x++){
+				uint64_t bit = first + x;
+				mask |= (uint32_t)((bits[bit >> 3] >> (bit & 7)) & 1) << x;
+			}
+			rows[i * glyphheight + y] = mask;
+		}
+	}
+
+	memset(pages, 0xff, pagesize);
+	memcpy(fontpagemap, pagemap, npagemap * sizeof(uint16_t));
+	for(i = 0; i < nmap; i++){
+		pages[pagemap[map[i].codepoint >> 8] * 256 + (map[i].codepoint & 255)] = map[i].glyph;
+	}
+
+#ifdef MC_MULTITHREADED
+	atomic_init(&font->refs, 1);
+#else
+	font->refs = 1;
+#endif
+	font->glyphwidth = glyphwidth;
+	font->glyphheight = glyphheight;
+	font->nglyphs = num;
+	font->rows = rows;
+	font->pagemap = fontpagemap;
+	font->pages = pages;
+	font->npagemap = npagemap;
+	font->replacement = -1;
+	font->replacement = _mc_font_glyph(font, '?');
+
+	return font;
+}
+
+MC_API int mc_font_retain(struct mc_font *font)
+{
+	MC_ASSERT(font);
+
+#ifdef MC_MULTITHREADED
+	if(atomic_load_explicit(&font->refs, memory_order_relaxed) >= 0){
+		atomic_fetch_add_explicit(&font->refs, 1, memory_order_relaxed);
+	}
+#else
+	if(font->refs >= 0){
+		font->refs++;
+	}
+#endif
+
+	return 0;
+}
+
+MC_API int mc_font_release(struct mc_font *font)
+{
+	if(!font){
+		return 0;
+	}
+
+#ifdef MC_MULTITHREADED
+	if(atomic_load_explicit(&font->refs, memory_order_relaxed) >= 0 && atomic_fetch_sub_explicit(&font->refs, 1, memory_order_acq_rel) == 1){
+		MC_FREE(font);
+	}
+#else
+	if(font->refs >= 0 && --font->refs == 0){
+		MC_FREE(font);
+	}
+#endif
+
+	return 0;
+}
+
+// Pixerif, converted with ccfconv (ccFont) and expanded to the runtime layout by tools/fontgen, run make default there to update it
+// fontgen begin
+// Generated by tools/fontgen from pixerif.ccf, don't edit
+static const uint32_t _mc_default_font_rows[1920] = {
+	0x0, 0x0, 0x0, 0x0, 0x1, 0x1, 0x1, 0x1,
+	0x1, 0x1, 0x0, 0x1, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x5, 0x5, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x28, 0x28, 0x7e, 0x14, 0x14, 0x3f,
+	0xa, 0xa, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x4, 0x1e, 0x15, 0x5, 0xe, 0x14, 0x14, 0x15,
+	0xf, 0x4, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x26, 0x29, 0x19, 0x16, 0x68, 0x98, 0x94, 0x64,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x1c,
+	0x12, 0x2, 0xe6, 0x49, 0x51, 0x21, 0xde, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x2, 0x2,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x4, 0x2, 0x1,
+	0x1, 0x1, 0x1, 0x2, 0x4, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x1, 0x2, 0x4, 0x4,
+	0x4, 0x4, 0x2, 0x1, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x15, 0xe, 0xe, 0x15, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x4, 0x4, 0x1f, 0x4,
+	0x4, 0x0, 0x0, 0x800, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x1, 0x1, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0xf, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x1, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x8, 0x8,
+	0x4, 0x4, 0x2, 0x2, 0x1, 0x1, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0xc, 0x12, 0x21,
+	0x21, 0x21, 0x21, 0x12, 0xc, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x2, 0x3, 0x2, 0x2,
+	0x2, 0x2, 0x2, 0x7, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0xf, 0x10, 0x10, 0x8, 0x4,
+	0x2, 0x11, 0x1f, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0xf, 0x11, 0x10, 0xc, 0x10, 0x10,
+	0x11, 0xf, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x4, 0x4, 0x2, 0xa, 0x9, 0x1f, 0x8,
+	0x8, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x1f, 0x1, 0x1, 0xf, 0x10, 0x10, 0x11, 0xf,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xc,
+	0x2, 0x1, 0xf, 0x11, 0x11, 0x11, 0xe, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x1f, 0x10,
+	0x8, 0x8, 0x4, 0x4, 0x2, 0x2, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0xe, 0x11, 0x11,
+	0xe, 0x11, 0x11, 0x11, 0xe, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0xe, 0x11, 0x11, 0x11,
+	0x1e, 0x10, 0x8, 0x7, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x1, 0x0,
+	0x0, 0x0, 0x1, 0x0, 0x800, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x1, 0x0, 0x0,
+	0x0, 0x1, 0x1, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x60, 0x18, 0x6, 0x18, 0x60,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x7e, 0x0, 0x7e, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x6, 0x18, 0x60, 0x18, 0x6, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xf, 0x10,
+	0x10, 0x8, 0x4, 0x2, 0x0, 0x2, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x78, 0x84, 0x172,
+	0x149, 0x145, 0x125, 0xf9, 0x202, 0x1fc, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x8, 0x8, 0x14, 0x14,
+	0x1c, 0x22, 0x22, 0x77, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0xf, 0x12, 0x12, 0x1e, 0x22,
+	0x22, 0x22, 0x1f, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x1c, 0x12, 0x1, 0x1, 0x1, 0x1,
+	0x12, 0x1c, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0xf, 0x12, 0x22, 0x22, 0x22, 0x22, 0x12,
+	0xf, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x1f, 0x12, 0x2, 0xe, 0x2, 0x2, 0x12, 0x1f,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x1f,
+	0x12, 0x2, 0xe, 0x2, 0x2, 0x2, 0x7, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x1c, 0x12,
+	0x1, 0x1, 0x19, 0x11, 0x12, 0x1c, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x77, 0x22, 0x22,
+	0x3e, 0x22, 0x22, 0x22, 0x77, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x7, 0x2, 0x2, 0x2,
+	0x2, 0x2, 0x2, 0x7, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0xe, 0x8, 0x8, 0x8, 0x8,
+	0x8, 0x9, 0x6, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x77, 0x22, 0x12, 0xe, 0xa, 0x12,
+	0x22, 0x77, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x7, 0x2, 0x2, 0x2, 0x2, 0x2, 0x12,
+	0x1f, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0xc3, 0x66, 0x66, 0x5a, 0x5a, 0x42, 0x42, 0xe7,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x73,
+	0x26, 0x26, 0x2a, 0x2a, 0x32, 0x32, 0x27, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xc, 0x12,
+	0x21, 0x21, 0x21, 0x21, 0x12, 0xc, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0xf, 0x12, 0x12,
+	0xe, 0x2, 0x2, 0x2, 0x7, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0xc, 0x12, 0x21, 0x21,
+	0x21, 0x29, 0x12, 0x6c, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0xf, 0x12, 0x12, 0xe, 0xa,
+	0x12, 0x12, 0x37, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x1e, 0x11, 0x1, 0xe, 0x10, 0x10,
+	0x11, 0xf, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x1f, 0x15, 0x4, 0x4, 0x4, 0x4, 0x4,
+	0xe, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x77, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x1c,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x77,
+	0x22, 0x22, 0x22, 0x14, 0x14, 0x8, 0x8, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x707, 0x202,
+	0x222, 0x222, 0x154, 0x154, 0x88, 0x88, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x77, 0x22, 0x14,
+	0x8, 0x8, 0x14, 0x22, 0x77, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x77, 0x22, 0x14, 0x8,
+	0x8, 0x8, 0x8, 0x1c, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x1f, 0x11, 0x8, 0x4, 0x2,
+	0x1, 0x11, 0x1f, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x7, 0x1, 0x1, 0x1, 0x1, 0x1,
+	0x1, 0x7, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x1, 0x1, 0x2, 0x2, 0x4, 0x4, 0x8,
+	0x8, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x7, 0x4, 0x4, 0x4, 0x4, 0x4, 0x4, 0x7,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x8,
+	0x14, 0x22, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x7f, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x1, 0x2, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x7, 0x8,
+	0xe, 0x9, 0x9, 0x1e, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x3, 0x2, 0xe, 0x12, 0x12,
+	0x12, 0x12, 0xd, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0xe, 0x9, 0x1, 0x1,
+	0x9, 0xe, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0xc, 0x8, 0xe, 0x9, 0x9, 0x9, 0x9,
+	0x16, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x6, 0x9, 0xf, 0x1, 0x9, 0xe,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xc,
+	0x2, 0x7, 0x2, 0x2, 0x2, 0x2, 0x7, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x16, 0x9, 0x9, 0x9, 0x9, 0xe, 0x8, 0x7,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x3, 0x2, 0xe,
+	0x12, 0x12, 0x12, 0x12, 0x37, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x2, 0x0, 0x3, 0x2,
+	0x2, 0x2, 0x2, 0x7, 0x0, 0x800, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x2, 0x0, 0x3, 0x2, 0x2,
+	0x2, 0x2, 0x2, 0x2, 0x1, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x3, 0x2, 0x12, 0xa, 0x6, 0xa,
+	0xa, 0x17, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1,
+	0x6, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x6d, 0x92, 0x92, 0x92, 0x92, 0x1b7,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0xd, 0x12, 0x12, 0x12, 0x12, 0x37, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x6, 0x9, 0x9, 0x9, 0x9, 0x6, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0xd,
+	0x12, 0x12, 0x12, 0x12, 0xe, 0x2, 0x7, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x16, 0x9,
+	0x9, 0x9, 0x9, 0xe, 0x8, 0x1c, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0xd, 0xa, 0x2,
+	0x2, 0x2, 0x7, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0xe, 0x1, 0x6, 0x8,
+	0x9, 0x7, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x2, 0x7, 0x2, 0x2, 0x2, 0x2,
+	0x4, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x1b, 0x12, 0x12, 0x12, 0x12, 0x2c,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x77, 0x22, 0x22, 0x14, 0x14, 0x8, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x1c7, 0x82, 0x92, 0x54, 0x54, 0x28, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x33,
+	0x12, 0xc, 0xc, 0x12, 0x33, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x33, 0x12,
+	0x12, 0xc, 0xc, 0x8, 0x4, 0x6, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0x0, 0x0, 0xf, 0x9, 0x4,
+	0x2, 0x9, 0xf, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x18, 0x4, 0x4, 0x4, 0x4, 0x3, 0x4,
+	0x4, 0x4, 0x4, 0x18, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1,
+	0x1, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x3,
+	0x4, 0x4, 0x4, 0x4, 0x18, 0x4, 0x4, 0x4,
+	0x4, 0x3, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x6, 0x49, 0x30, 0x0, 0x0, 0x0,
+	0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0,
+	0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0,
+	0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0, 0x0,
+	0xe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x1e, 0x0, 0x0, 0x0, 0x0, 0xe,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x1e, 0x0, 0x0, 0x0, 0x0, 0xe, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x1e, 0x0, 0x0, 0x0, 0x0, 0xe, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e,
+	0x0, 0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0,
+	0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0,
+	0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0,
+	0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0, 0x0,
+	0xe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x1e, 0x0, 0x0, 0x0, 0x0, 0xe,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x1e, 0x0, 0x0, 0x0, 0x0, 0xe, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x1e, 0x0, 0x0, 0x0, 0x0, 0xe, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e,
+	0x0, 0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0,
+	0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0,
+	0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0,
+	0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0, 0x0,
+	0xe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x1e, 0x0, 0x0, 0x0, 0x0, 0xe,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x1e, 0x0, 0x0, 0x0, 0x0, 0xe, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x1e, 0x0, 0x0, 0x0, 0x0, 0xe, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e,
+	0x0, 0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0,
+	0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0,
+	0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0,
+	0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0, 0x0,
+	0xe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x1e, 0x0, 0x0, 0x0, 0x0, 0xe,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x1e, 0x0, 0x0, 0x0, 0x0, 0xe, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x1e, 0x0, 0x0, 0x0, 0x0, 0xe, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e,
+	0x0, 0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0,
+	0x0, 0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0,
+	0x0, 0x0, 0xe, 0x10, 0x10, 0x10, 0x10, 0x10,
+	0x10, 0x10, 0x10, 0x10, 0x1e, 0x0, 0x0, 0x0
+};
+static const uint16_t _mc_default_font_pagemap[35] = {
+	1, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	2, 0, 3
+};
+static const int16_t _mc_default_font_pages[1024] = {
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 0, 1, 2, 3, 4, 5, 6,
+	7, 8, 9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22,
+	23, 24, 25, 26, 27, 28, 29, 30,
+	31, 32, 33, 34, 35, 36, 37, 38,
+	39, 40, 41, 42, 43, 44, 45, 46,
+	47, 48, 49, 50, 51, 52, 53, 54,
+	55, 56, 57, 58, 59, 60, 61, 62,
+	63, 64, 65, 66, 67, 68, 69, 70,
+	71, 72, 73, 74, 75, 76, 77, 78,
+	79, 80, 81, 82, 83, 84, 85, 86,
+	87, 88, 89, 90, 91, 92, 93, 94,
+	95, 96, 97, 98, 99, 100, 101, 102,
+	103, 104, 105, 106, 107, 108, 109, 110,
+	111, 112, 113, 114, 115, 116, 117, 118,
+	119, 120, 121, 122, 123, 124, 125, 126,
+	127, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, 27, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, 29, -1, -1, -1, -1,
+	32, 32, 32, 32, 32, 32, 32, 34,
+	36, 36, 36, 36, 40, 40, 40, 40,
+	35, 45, 46, 46, 46, 46, 46, 87,
+	46, 52, 52, 52, 52, 56, 47, 82,
+	64, 64, 64, 64, 64, 64, 64, 66,
+	68, 68, 68, 68, 72, 72, 72, 72,
+	67, 77, 78, 78, 78, 78, 78, 14,
+	78, 84, 84, 84, 84, 88, 79, 88,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	12, 12, 12, 12, 12, -1, -1, -1,
+	6, 6, -1, -1, 1, 1, -1, -1,
+	-1, -1, 9, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 27, 29, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, 12, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1
+};
+static struct mc_font _mc_default_font = {
+	-1, 12, 15, 128, _mc_default_font_rows, _mc_default_font_pagemap, _mc_default_font_pages, 35, 30
+};
+// fontgen end
+
+MC_API struct mc_font *mc_font_default()
+{
+	return &_mc_default_font;
+}
+
+MC_API int mc_blit_self_check()
+{
+	const struct mc_font *font = &_mc_default_font;
+#ifdef MC_OUTPUT_TEXTURE_INDEXED8
+	const struct mc_pixel colors[] = {{0}, {255}, {12}};
+#else
+	const struct mc_pixel colors[] = {
+		{0, 0, 0
+#if defined MC_OUTPUT_TEXTURE_RGBA || defined MC_OUTPUT_TEXTURE_BGRA
+			,0
+#endif
+		},
+		{255, 255, 255
+#if defined MC_OUTPUT_TEXTURE_RGBA || defined MC_OUTPUT_TEXTURE_BGRA
+			,255
+#endif
+		},
+		{12, 34, 56
+#if defined MC_OUTPUT_TEXTURE_RGBA || defined MC_OUTPUT_TEXTURE_BGRA
+			,78
+#endif
+		}
+	};
+#endif
+	const int ncolors = sizeof(colors) / sizeof(colors[0]);
+
+	// The padding around the row catches writes outside of it
+	struct mc_pixel expect[32 + 2], got[32 + 2];
+	struct _mc_blit_colors col;
+
+	uint32_t seed = 0x9e3779b9;
+	int i, width;
+	for(i = 0; i < (int)(font->nglyphs * font->glyphheight) + 4096; i++){
+		uint32_t mask;
+		if(i < (int)(font->nglyphs * font->glyphheight)){
+			mask = font->rows[i];
+			width = font->glyphwidth;
+		}else{
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			mask = seed;
+			width = 1 + (i & 31);
+		}
+
+		int c = i % (ncolors * ncolors);
+		_mc_blit_colors_set(&col, width, colors[c % ncolors], colors[c / ncolors]);
+
+		memset(expect, 0xa5, sizeof(expect));
+		memset(got, 0xa5, sizeof(got));
+		_mc_blit_row_scalar(expect + 1, mask, width, &col);
+		_mc_blit_row(got + 1, mask, width, &col);
+		if(memcmp(expect, got, sizeof(expect)) != 0){
+			return -2;
+		}
+	}
+
+	return 0;
+}
+
+static unsigned _mc_rect_area(struct mc_rect r)
+{
+	return r.width * r.height;
+}
+
+static struct mc_rect _mc_rect_union(struct mc_rect a, struct mc_rect b)
+{
+	unsigned x2 = a.x + a.width > b.x + b.width ? a.x + a.width : b.x + b.width;
+	unsigned y2 = a.y + a.height > b.y + b.height ? a.y + a.height : b.y + b.height;
+	struct mc_rect r;
+	r.x = a.x < b.x ? a.x : b.x;
+	r.y = a.y < b.y ? a.y : b.y;
+	r.width = x2 - r.x;
+	r.height = y2 - r.y;
+
+	return r;
+}
+
+MC_API int mc_damage(struct mc_console *con, unsigned x, unsigned y, unsigned width, unsigned height)
+{
+	MC_ASSERT(con);
+
+	if(x >= con->width || y >= con->height || width == 0 || height == 0){
+		return 0;
+	}
+	struct mc_rect r = {x, y, width, height};
+	if(r.width > con->width - x){
+		r.width = con->width - x;
+	}
+	if(r.height > con->height - y){
+		r.height = con->height - y;
+	}
+
+	con->outupdate = true;
+
+	unsigned i;
+restart:
+	// Merge with every rectangle where the union doesn't cover more than both of them separately
+	for(i = 0; i < con->ndirty; i++){
+		struct mc_rect u = _mc_rect_union(r, con->dirty[i]);
+		if(_mc_rect_area(u) <= _mc_rect_area(r) + _mc_rect_area(con->dirty[i])){
+			r = u;
+			con->dirty[i] = con->dirty[--con->ndirty];
+			goto restart;
+		}
+	}
+
+	if(con->ndirty == MC_MAX_DIRTY_RECTS){
+		// Out of rectangles, merge with the one that grows the least
+		unsigned best = 0, bestgrowth = ~0u;
+		for(i = 0; i < con->ndirty; i++){
+			unsigned growth = _mc_rect_area(_mc_rect_union(r, con->dirty[i])) - _mc_rect_area(con->dirty[i]);
+			if(growth < bestgrowth){
+				best = i;
+				bestgrowth = growth;
+			}
+		}
+		r = _mc_rect_union(r, con->dirty[best]);
+		con->dirty[best] = con->dirty[--con->ndirty];
+		goto restart;
+	}
+
+	con->dirty[con->ndirty++] = r;
+
+	return 0;
+}
+
+MC_API unsigned mc_get_dirty_rects(struct mc_console *con, const struct mc_rect **rects)
+{
+	MC_ASSERT(con);
+
+	if(rects){
+		*rects = con->dirty;
+	}
+
+	return con->ndirty;
+}
+
+MC_API int mc_clear_dirty(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+#ifdef MC_STATS
+	unsigned i;
+	for(i = 0; i < con->ndirty; i++){
+		_MC_STAT(con, dirtyarea, (unsigned long)con->dirty[i].width * con->dirty[i].height);
+	}
+#endif
+
+	con->ndirty = 0;
+	con->outupdate = false;
+	con->palettedirty = false;
+
+	return 0;
+}
+
+MC_API int mc_fill_rect(struct mc_console *con, unsigned x, unsigned y, unsigned width, unsigned height, struct mc_pixel color)
+{
+	MC_ASSERT(con);
+
+	if(x + width > con->width || y + height > con->height){
+		return -3;
+	}
+
+	unsigned i, j;
+	for(j = 0; j < width; j++){
+		con->pixels[x + j + y * con->width] = color;
+	}
+	for(i = 1; i < height; i++){
+		memcpy(con->pixels + x + (y + i) * con->width, con->pixels + x + y * con->width, width * sizeof(struct mc_pixel));
+	}
+
+	_MC_STAT(con, pixels, (unsigned long)width * height);
+
+	return mc_damage(con, x, y, width, height);
+}
+
+MC_API int mc_clear(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	struct mc_pixel bg = _mc_palette_pixel(con, MC_DEFAULT_BG);
+	unsigned i;
+	for(i = 0; i < con->width * con->height; i++){
+		con->pixels[i] = bg;
+	}
+
+	_MC_STAT(con, pixels, (unsigned long)con->width * con->height);
+
+	return mc_damage(con, 0, 0, con->width, con->height);
+}
+
+// The xterm colors: 16 ANSI colors, a 6x6x6 cube and a gray ramp. Entry 0 is transparent, like the background always was.
+static struct mc_color _mc_palette_xterm(unsigned i)
+{
+	static const unsigned char ansi[16][3] = {
+		{0, 0, 0}, {205, 0, 0}, {0, 205, 0}, {205, 205, 0}, {0, 0, 238}, {205, 0, 205}, {0, 205, 205}, {229, 229, 229},
+		{127, 127, 127}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0}, {92, 92, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255}
+	};
+	static const unsigned char levels[6] = {0, 95, 135, 175, 215, 255};
+
+	if(i < 16){
+		return (struct mc_color){ansi[i][0], ansi[i][1], ansi[i][2], i == 0 ? 0 : 255};
+	}
+	if(i < 232){
+		i -= 16;
+		return (struct mc_color){levels[i / 36], levels[i / 6 % 6], levels[i % 6], 255};
+	}
+	unsigned char gray = 8 + (i - 232) * 10;
+	return (struct mc_color){gray, gray, gray, 255};
+}
+
+static void _mc_palette_update(struct mc_console *con, unsigned first, unsigned n)
+{
+#ifndef MC_OUTPUT_TEXTURE_INDEXED8
+	unsigned i;
+	for(i = first; i < first + n; i++){
+		struct mc_color c = con->palette[i];
+		con->palettepixels[i] = _MC_PIXEL(c.r, c.g, c.b, c.a);
+	}
+#endif
+	con->palettedirty = true;
+}
+
+static void _mc_palette_default(struct mc_console *con)
+{
+	unsigned i;
+	for(i = 0; i < 256; i++){
+		con->palette[i] = _mc_palette_xterm(i);
+	}
+	_mc_palette_update(con, 0, 256);
+}
+
+MC_API int mc_set_palette(struct mc_console *con, unsigned first, unsigned n, const struct mc_color *colors)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(colors || n == 0);
+
+	if(first > 256 || n > 256 - first){
+		return -2;
+	}
+
+	memcpy(con->palette + first, colors, n * sizeof(struct mc_color));
+	_mc_palette_update(con, first, n);
+
+#ifndef MC_OUTPUT_TEXTURE_INDEXED8
+	// The colors are in the pixels, so every cell is presented again on the next render
+	if(con->cells){
+		unsigned i;
+		for(i = 0; i < con->outwidth * con->outheight; i++){
+			con->prevcells[i] = _MC_NO_CELL;
+		}
+		con->outlaidline = _MC_NO_LINE;
+		con->outdirty = con->indirty = true;
+	}
+	if(con->pixels){
+		mc_clear(con);
+	}
+#endif
+
+	return 0;
+}
+
+MC_API const struct mc_color *mc_get_palette(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	return con->palette;
+}
+
+MC_API bool mc_palette_dirty(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	return con->palettedirty;
+}
+
+struct _mc_glyph_tile {
+	int glyph;
+	struct mc_pixel fg, bg;
+	// Least recently used list, the head is the most recent tile
+	int prev, next;
+	// Next tile in the same hash bucket
+	int chain;
+};
+
+// Allocated as a single block: the buckets, tiles and tile pixels follow the struct
+struct _mc_glyph_cache {
+	int ntiles, maxtiles;
+	int head, tail;
+	unsigned bucketmask;
+	int *buckets;
+	struct _mc_glyph_tile *tiles;
+	struct mc_pixel *pixels;
+};
+
+static unsigned _mc_glyph_hash(int glyph, struct mc_pixel fg, struct mc_pixel bg)
+{
+	uint32_t h = 2166136261u ^ (uint32_t)glyph;
+	const unsigned char *b = (const unsigned char*)&fg;
+	unsigned i;
+	for(i = 0; i < sizeof(struct mc_pixel); i++){
+		h = (h ^ b[i]) * 16777619u;
+	}
+	b = (const unsigned char*)&bg;
+	for(i = 0; i < sizeof(struct mc_pixel); i++){
+		h = (h ^ b[i]) * 16777619u;
+	}
+
+	return h ^ (h >> 15);
+}
+
+static struct _mc_glyph_cache *_mc_glyph_cache_create(struct mc_console *con, unsigned budget)
+{
+	unsigned tilesize = con->font->glyphwidth * con->font->glyphheight * sizeof(struct mc_pixel);
+	int maxtiles = budget / tilesize;
+	if(maxtiles == 0){
+		return NULL;
+	}
+
+	unsigned nbuckets = 1;
+	while(nbuckets < (unsigned)maxtiles){
+		nbuckets <<= 1;
+	}
+
+	struct _mc_glyph_cache *cache = (struct _mc_glyph_cache*)_mc_malloc(con, sizeof(struct _mc_glyph_cache) +
+			nbuckets * sizeof(int) + maxtiles * (sizeof(struct _mc_glyph_tile) + tilesize));
+	if(!cache){
+		return NULL;
+	}
+
+	cache->ntiles = 0;
+	cache->maxtiles = maxtiles;
+	cache->head = cache->tail = -1;
+	cache->bucketmask = nbuckets - 1;
+	cache->buckets = (int*)(cache + 1);
+	cache->tiles = (struct _mc_glyph_tile*)(cache->buckets + nbuckets);
+	cache->pixels = (struct mc_pixel*)(cache->tiles + maxtiles);
+	memset(cache->buckets, 0xff, nbuckets * sizeof(int));
+
+	return cache;
+}
+
+static void _mc_glyph_cache_unlink(struct _mc_glyph_cache *cache, int i)
+{
+	struct _mc_glyph_tile *t = cache->tiles + i;
+	if(t->prev >= 0){
+		cache->tiles[t->prev].next = t->next;
+	}else{
+		cache->head = t->next;
+	}
+	if(t->next >= 0){
+		cache->tiles[t->next].prev = t->prev;
+	}else{
+		cache->tail = t->prev;
+	}
+}
+
+static void _mc_glyph_cache_push(struct _mc_glyph_cache *cache, int i)
+{
+	struct _mc_glyph_tile *t = cache->tiles + i;
+	t->prev = -1;
+	t->next = cache->head;
+	if(cache->head >= 0){
+		cache->tiles[cache->head].prev = i;
+	}else{
+		cache->tail = i;
+	}
+	cache->head = i;
+}
+
+// Returns the pixels of the tile, rendering it first when it's not in the cache
+static const struct mc_pixel *_mc_glyph_cache_get(struct _mc_glyph_cache *cache, const struct mc_font *font, int c, struct mc_pixel fg, struct mc_pixel bg)
+{
+	int tilelen = font->glyphwidth * font->glyphheight;
+	unsigned bucket = _mc_glyph_hash(c, fg, bg) & cache->bucketmask;
+
+	int i;
+	for(i = cache->buckets[bucket]; i >= 0; i = cache->tiles[i].chain){
+		struct _mc_glyph_tile *t = cache->tiles + i;
+		if(t->glyph == c && memcmp(&t->fg, &fg, sizeof(struct mc_pixel)) == 0 && memcmp(&t->bg, &bg, sizeof(struct mc_pixel)) == 0){
+			if(cache->head != i){
+				_mc_glyph_cache_unlink(cache, i);
+				_mc_glyph_cache_push(cache, i);
+			}
+			return cache->pixels + i * tilelen;
+		}
+	}
+
+	if(cache->ntiles < cache->maxtiles){
+		i = cache->ntiles++;
+	}else{
+		// Evict the least recently used tile
+		i = cache->tail;
+		struct _mc_glyph_tile *old = cache->tiles + i;
+		int *link = cache->buckets + (_mc_glyph_hash(old->glyph, old->fg, old->bg) & cache->bucketmask);
+		while(*link != i){
+			link = &cache->tiles[*link].chain;
+		}
+		*link = old->chain;
+		_mc_glyph_cache_unlink(cache, i);
+	}
+
+	struct _mc_glyph_tile *t = cache->tiles + i;
+	t->glyph = c;
+	t->fg = fg;
+	t->bg = bg;
+	t->chain = cache->buckets[bucket];
+	cache->buckets[bucket] = i;
+	_mc_glyph_cache_push(cache, i);
+
+	struct mc_pixel *pixels = cache->pixels + i * tilelen;
+	const uint32_t *rows = font->rows + c * font->glyphheight;
+	struct _mc_blit_colors col;
+	_mc_blit_colors_set(&col, font->glyphwidth, fg, bg);
+	unsigned y;
+	for(y = 0; y < font->glyphheight; y++){
+		_mc_blit_row(pixels + y * font->glyphwidth, rows[y], font->glyphwidth, &col);
+	}
+
+	return pixels;
+}
+
+// The budget is split over the render threads, the first one renders on the calling thread with con->glyphcache
+static unsigned _mc_glyph_cache_budget(const struct mc_console *con)
+{
+#ifdef MC_MULTITHREADED
+	return con->glyphcachesize / con->nrenderthreads;
+#else
+	return con->glyphcachesize;
+#endif
+}
+
+MC_API int mc_set_glyph_cache_size(struct mc_console *con, unsigned bytes)
+{
+	MC_ASSERT(con);
+
+	_mc_free(con, con->glyphcache);
+	con->glyphcache = NULL;
+	con->glyphcachesize = bytes;
+#ifdef MC_MULTITHREADED
+	unsigned i;
+	for(i = 0; i < con->nrenderthreads; i++){
+		_mc_free(con, con->renderthreads[i].glyphcache);
+		con->renderthreads[i].glyphcache = NULL;
+	}
+#endif
+
+	return 0;
+}
+
+MC_API int mc_set_font(struct mc_console *con, struct mc_font *font)
+{
+	MC_ASSERT(con);
+	MC_ASSERT(font);
+
+	if(font == con->font){
+		return 0;
+	}
+	mc_font_retain(font);
+	mc_font_release(con->font);
+	con->font = font;
+
+	// The cached tiles are of the old glyphs and possibly of another size
+	mc_set_glyph_cache_size(con, con->glyphcachesize);
+	if(con->pixels){
+		return mc_set_texture_size(con, con->width, con->height);
+	}
+
+	return 0;
+}
+
+MC_API int mc_blit_glyph(struct mc_console *con, unsigned x, unsigned y, uint32_t codepoint, struct mc_pixel fg, struct mc_pixel bg)
+{
+	MC_ASSERT(con);
+
+	int c = _mc_font_glyph(con->font, codepoint);
+	if(c < 0){
+		return -2;
+	}
+	if(x + con->font->glyphwidth > con->width || y + con->font->glyphheight > con->height){
+		return -3;
+	}
+
+	if(!con->glyphcache && con->glyphcachesize > 0){
+		con->glyphcache = _mc_glyph_cache_create(con, _mc_glyph_cache_budget(con));
+	}
+
+	unsigned i;
+	if(con->glyphcache){
+		const struct mc_pixel *tile = _mc_glyph_cache_get(con->glyphcache, con->font, c, fg, bg);
+		for(i = 0; i < con->font->glyphheight; i++){
+			memcpy(con->pixels + x + (y + i) * con->width, tile + i * con->font->glyphwidth, con->font->glyphwidth * sizeof(struct mc_pixel));
+		}
+	}else{
+		const uint32_t *rows = con->font->rows + c * con->font->glyphheight;
+		struct _mc_blit_colors col;
+		_mc_blit_colors_set(&col, con->font->glyphwidth, fg, bg);
+		for(i = 0; i < con->font->glyphheight; i++){
+			_mc_blit_row(con->pixels + x + (y + i) * con->width, rows[i], con->font->glyphwidth, &col);
+		}
+	}
+
+	_MC_STAT(con, glyphs, 1);
+	_MC_STAT(con, pixels, con->font->glyphwidth * con->font->glyphheight);
+
+	return mc_damage(con, x, y, con->font->glyphwidth, con->font->glyphheight);
+}
+
+MC_API int mc_blit_glyph_default(struct mc_console *con, unsigned x, unsigned y, uint32_t codepoint)
+{
+	return mc_blit_glyph(con, x, y, codepoint, _mc_palette_pixel(con, MC_DEFAULT_FG), _mc_palette_pixel(con, MC_DEFAULT_BG));
+}
+
+MC_API int mc_set_texture_size(struct mc_console *con, unsigned width, unsigned height)
+{
+	MC_ASSERT(con);
+
+	struct mc_pixel *pixels = (struct mc_pixel*)_mc_realloc(con, con->pixels, width * height * sizeof(struct mc_pixel));
+	if(!pixels){
+		return -1;
+	}
+	con->pixels = pixels;
+
+	con->width = width;
+	con->height = height;
+
+	// The whole texture needs to be uploaded again
+	con->ndirty = 0;
+	mc_clear(con);
+
+	return mc_set_grid_size(con, width / con->font->glyphwidth, height / con->font->glyphheight);
+}
+
+static void _mc_present_cell(struct mc_console *con, unsigned x, unsigned y, struct mc_cell cell)
+{
+	struct mc_pixel fg, bg;
+	_mc_cell_pixels(con, cell, &fg, &bg);
+
+	unsigned px = x * con->font->glyphwidth, py = y * con->font->glyphheight;
+	if(mc_blit_glyph(con, px, py, cell.glyph, fg, bg) == -2){
+		// Glyphs that are not in the font, like space, are drawn as the background
+		mc_fill_rect(con, px, py, con->font->glyphwidth, con->font->glyphheight, bg);
+	}
+}
+
+#ifdef MC_MULTITHREADED
+#define _MC_RANGE(first, end) (((unsigned long long)(first) << 32) | (end))
+
+// Present a row of cells like _mc_present_cell with the glyph cache of the thread and without the damage and counters, which aren't thread safe
+static void _mc_raster_band(struct mc_console *con, unsigned y, struct _mc_glyph_cache *cache)
+{
+	unsigned cols = con->outwidth, gw = con->font->glyphwidth, gh = con->font->glyphheight;
+	struct _mc_band *band = con->bands + y;
+	band->x0 = cols;
+	band->x1 = band->cells = band->glyphs = 0;
+
+	unsigned x;
+	for(x = 0; x < cols; x++){
+		struct mc_cell cell = con->cells[x + y * cols];
+		struct mc_cell *prev = con->prevcells + x + y * cols;
+		if(_mc_cell_equal(cell, *prev)){
+			continue;
+		}
+		*prev = cell;
+		if((x + 1) * gw > con->width || (y + 1) * gh > con->height){
+			continue;
+		}
+
+		struct mc_pixel fg, bg;
+		_mc_cell_pixels(con, cell, &fg, &bg);
+
+		struct mc_pixel *pixels = con->pixels + x * gw + y * gh * con->width;
+		int c = _mc_font_glyph(con->font, cell.glyph);
+		unsigned i, j;
+		if(c >= 0 && cache){
+			const struct mc_pixel *tile = _mc_glyph_cache_get(cache, con->font, c, fg, bg);
+			for(i = 0; i < gh; i++){
+				memcpy(pixels + i * con->width, tile + i * gw, gw * sizeof(struct mc_pixel));
+			}
+			band->glyphs++;
+		}else if(c >= 0){
+			const uint32_t *rows = con->font->rows + c * gh;
+			struct _mc_blit_colors col;
+			_mc_blit_colors_set(&col, gw, fg, bg);
+			for(i = 0; i < gh; i++){
+				_mc_blit_row(pixels + i * con->width, rows[i], gw, &col);
+			}
+			band->glyphs++;
+		}else{
+			for(i = 0; i < gh; i++){
+				for(j = 0; j < gw; j++){
+					pixels[j + i * con->width] = bg;
+				}
+			}
+		}
+
+		if(x < band->x0){
+			band->x0 = x;
+		}
+		band->x1 = x + 1;
+		band->cells++;
+	}
+}
+
+// Rasterize the rows in the range of thread self, then steal the back half of the range of another thread until all are empty
+static void _mc_render_work(struct mc_console *con, unsigned self)
+{
+	unsigned n = con->nrenderthreads;
+	atomic_ullong *own = &con->renderthreads[self].range;
+	struct _mc_glyph_cache *cache = self == 0 ? con->glyphcache : con->renderthreads[self].glyphcache;
+	for(;;){
+		unsigned long long r = atomic_load(own);
+		if((unsigned)(r >> 32) < (unsigned)r){
+			if(atomic_compare_exchange_weak(own, &r, r + (1ull << 32))){
+				_mc_raster_band(con, (unsigned)(r >> 32), cache);
+			}
+			continue;
+		}
+
+		unsigned i;
+		bool stolen = false;
+		for(i = 1; i < n && !stolen; i++){
+			atomic_ullong *victim = &con->renderthreads[(self + i) % n].range;
+			unsigned long long v = atomic_load(victim);
+			while((unsigned)(v >> 32) < (unsigned)v){
+				unsigned first = (unsigned)(v >> 32), end = (unsigned)v;
+				unsigned mid = first + (end - first) / 2;
+				if(atomic_compare_exchange_weak(victim, &v, _MC_RANGE(first, mid))){
+					atomic_store(own, _MC_RANGE(mid, end));
+					stolen = true;
+					break;
+				}
+			}
+		}
+		if(!stolen){
+			return;
+		}
+	}
+}
+
+static int _mc_render_worker(void *arg)
+{
+	struct _mc_render_thread *thread = (struct _mc_render_thread*)arg;
+	struct mc_console *con = thread->con;
+
+	unsigned gen = 0;
+	mtx_lock(&con->rendermutex);
+	for(;;){
+		while(con->rendergen == gen && !con->renderquit){
+			cnd_wait(&con->renderstart, &con->rendermutex);
+		}
+		if(con->renderquit){
+			break;
+		}
+		gen = con->rendergen;
+		mtx_unlock(&con->rendermutex);
+
+		_mc_render_work(con, thread - con->renderthreads);
+
+		mtx_lock(&con->rendermutex);
+		if(--con->renderbusy == 0){
+			cnd_signal(&con->renderdone);
+		}
+	}
+	mtx_unlock(&con->rendermutex);
+
+	return 0;
+}
+
+// Present the rows first to last split in bands over the render threads, the pixels are the same as on one thread
+static int _mc_render_parallel(struct mc_console *con, unsigned first, unsigned last)
+{
+	if(!con->bands){
+		con->bands = (struct _mc_band*)_mc_malloc(con, con->outheight * sizeof(struct _mc_band));
+		if(!con->bands){
+			return -1;
+		}
+	}
+
+	unsigned n = con->nrenderthreads, count = last - first, i;
+	if(!con->glyphcache && con->glyphcachesize > 0){
+		con->glyphcache = _mc_glyph_cache_create(con, _mc_glyph_cache_budget(con));
+	}
+	for(i = 0; i < n; i++){
+		// The allocator is only called from this thread
+		if(i > 0 && !con->renderthreads[i].glyphcache && con->glyphcachesize > 0){
+			con->renderthreads[i].glyphcache = _mc_glyph_cache_create(con, _mc_glyph_cache_budget(con));
+		}
+		atomic_store(&con->renderthreads[i].range, _MC_RANGE(first + count * i / n, first + count * (i + 1) / n));
+	}
+
+	mtx_lock(&con->rendermutex);
+	con->rendergen++;
+	con->renderbusy = n - 1;
+	cnd_broadcast(&con->renderstart);
+	mtx_unlock(&con->rendermutex);
+
+	_mc_render_work(con, 0);
+
+	mtx_lock(&con->rendermutex);
+	while(con->renderbusy > 0){
+		cnd_wait(&con->renderdone, &con->rendermutex);
+	}
+	mtx_unlock(&con->rendermutex);
+
+	unsigned gw = con->font->glyphwidth, gh = con->font->glyphheight;
+	for(i = first; i < last; i++){
+		const struct _mc_band *band = con->bands + i;
+		if(band->cells == 0){
+			continue;
+		}
+		mc_damage(con, band->x0 * gw, i * gh, (band->x1 - band->x0) * gw, gh);
+		_MC_STAT(con, glyphs, band->glyphs);
+		_MC_STAT(con, pixels, (unsigned long)band->cells * gw * gh);
+	}
+
+	return 0;
+}
+
+MC_API int mc_set_render_threads(struct mc_console *con, unsigned n)
+{
+	MC_ASSERT(con);
+
+	if(n == 0 || n > MC_MAX_RENDER_THREADS){
+		return -2;
+	}
+
+	// The caches are sized for the number of threads
+	mc_set_glyph_cache_size(con, con->glyphcachesize);
+	if(con->nrenderthreads > 1){
+		mtx_lock(&con->rendermutex);
+		con->renderquit = true;
+		cnd_broadcast(&con->renderstart);
+		mtx_unlock(&con->rendermutex);
+
+		unsigned i;
+		for(i = 1; i < con->nrenderthreads; i++){
+			thrd_join(con->renderthreads[i].thread, NULL);
+		}
+		cnd_destroy(&con->renderdone);
+		cnd_destroy(&con->renderstart);
+		mtx_destroy(&con->rendermutex);
+	}
+	con->nrenderthreads = 1;
+	if(n == 1){
+		return 0;
+	}
+
+	if(mtx_init(&con->rendermutex, mtx_plain) != thrd_success){
 		return -1;
 	}
+	if(cnd_init(&con->renderstart) != thrd_success){
+		goto nostart;
+	}
+	if(cnd_init(&con->renderdone) != thrd_success){
+		goto nodone;
+	}
+	con->rendergen = 0;
+	con->renderquit = false;
+
+	unsigned i;
+	for(i = 0; i < n; i++){
+		con->renderthreads[i].con = con;
+		atomic_init(&con->renderthreads[i].range, 0);
+	}
+	for(; con->nrenderthreads < n; con->nrenderthreads++){
+		if(thrd_create(&con->renderthreads[con->nrenderthreads].thread, _mc_render_worker, con->renderthreads + con->nrenderthreads) != thrd_success){
+			break;
+		}
+	}
+	if(con->nrenderthreads > 1){
+		return con->nrenderthreads == n ? 0 : -1;
+	}
+
+	cnd_destroy(&con->renderdone);
+nodone:
+	cnd_destroy(&con->renderstart);
+nostart:
+	mtx_destroy(&con->rendermutex);
+
+	return -1;
+}
+#endif
+#endif // MC_OUTPUT_TEXTURE
 
-	_mc_default_font_glyph_width = _mc_default_font_bin[1];
-	_mc_default_font_glyph_height = _mc_default_font_bin[2];
-	_mc_default_font_glyph_start = _mc_default_font_bin[3];
-	_mc_default_font_glyph_num = _mc_default_font_bin[4];
+MC_API int mc_set_grid_size(struct mc_console *con, unsigned cols, unsigned rows)
+{
+	MC_ASSERT(con);
 
-	printf("w: %d, h: %d\n", _mc_default_font_glyph_width, _mc_default_font_glyph_height);
+	_mc_free(con, con->cells);
+	con->cells = con->prevcells = NULL;
+#if defined MC_MULTITHREADED && defined MC_OUTPUT_TEXTURE
+	_mc_free(con, con->bands);
+	con->bands = NULL;
+#endif
 
-#define _MC_UNPACK8TO32(b, c, i) \
-	b = (c[i] << 24) | (c[i + 1] << 16) | (c[i + 2] << 8) | c[i + 3];
-	unsigned totallen;
-	_MC_UNPACK8TO32(_mc_default_font_width, _mc_default_font_bin, 5);
-	_MC_UNPACK8TO32(totallen, _mc_default_font_bin, 9);
-#undef _MC_UNPACK8TO32
+	// The first character on the top row stays in view when the lines wrap differently
+	if(con->outscrolled && cols > 0 && con->outwidth > 0){
+		con->outtoprow = con->outtoprow * con->outwidth / cols;
+	}
+	con->outwidth = cols;
+	con->outheight = rows;
+	con->outdirty = con->indirty = true;
+	con->outlaidline = _MC_NO_LINE;
 
-	_mc_default_font_data = (unsigned char*)malloc(totallen);
+	if(cols == 0 || rows == 0){
+		return 0;
+	}
 
-	unsigned len = totallen >> 3;
-	unsigned char reminder = totallen % 8;
+	con->cells = (struct mc_cell*)_mc_malloc(con, 2 * cols * rows * sizeof(struct mc_cell));
+	if(!con->cells){
+		return -1;
+	}
+	con->prevcells = con->cells + cols * rows;
 
+	// Nothing is known about the presented cells yet so everything gets drawn
 	unsigned i;
-	for(i = 0; i < len; i++){
-		unsigned char j;
-		for(j = 0; j < 8; j++){
-			_mc_default_font_data[i * 8 + j] = (_mc_default_font_bin[i + 13] >> j) & 1;
+	for(i = 0; i < cols * rows; i++){
+		con->cells[i] = _MC_BLANK_CELL;
+		con->prevcells[i] = _MC_NO_CELL;
+	}
+
+	return 0;
+}
+
+// Decode the character at pos of a line ending at end and return its length
+static unsigned _mc_ring_next(const struct mc_ring *ring, unsigned pos, unsigned end, uint32_t *codepoint)
+{
+	char b[4];
+	b[0] = _mc_ring_char(ring, pos);
+	if((unsigned char)b[0] < 0x80){
+		*codepoint = (unsigned char)b[0];
+		return 1;
+	}
+
+	unsigned n;
+	for(n = 1; n < 4 && pos + n < end; n++){
+		b[n] = _mc_ring_char(ring, pos + n);
+	}
+
+	n = _mc_utf8_next(b, n, codepoint);
+	if(!_MC_IS_PRINTABLE_CODEPOINT(*codepoint)){
+		// Controls decoded from more than one byte are never passed on, a backend could send them to a terminal
+		*codepoint = _MC_REPLACEMENT;
+	}
+
+	return n;
+}
+
+// Fill a grid row with the characters of the output from pos, span is the span cursor of pos and moves along.
+// Returns where the next row starts.
+static unsigned _mc_layout_row(struct mc_cell *row, unsigned cols, const struct mc_console *con, unsigned pos, unsigned end, unsigned *span)
+{
+	unsigned char fg, bg;
+	_mc_span_colors(con, *span, &fg, &bg);
+
+	unsigned i;
+	for(i = 0; i < cols && pos < end; i++){
+		if(*span != con->spanend && (int)(_MC_SPAN(con, *span).pos - pos) <= 0){
+			*span = _mc_span_advance(con, *span, pos);
+			_mc_span_colors(con, *span, &fg, &bg);
+		}
+
+		uint32_t cp;
+		pos += _mc_ring_next(&con->out, pos, end, &cp);
+		row[i] = (struct mc_cell){cp, 0, fg, bg};
+	}
+	for(; i < cols; i++){
+		row[i] = _MC_BLANK_CELL;
+	}
+
+	return pos;
+}
+
+static void _mc_layout_blank(struct mc_cell *row, unsigned cols)
+{
+	unsigned i;
+	for(i = 0; i < cols; i++){
+		row[i] = _MC_BLANK_CELL;
+	}
+}
+
+static void _mc_wrap_add(struct mc_console *con, unsigned slot, unsigned delta)
+{
+	unsigned i;
+	for(i = slot + 1; i <= MC_MAX_OUTPUT_LINES; i += i & -i){
+		con->outtree[i - 1] += delta;
+	}
+}
+
+// Rows the slots before slot have on top of their first
+static unsigned _mc_wrap_prefix(const struct mc_console *con, unsigned slot)
+{
+	unsigned sum = 0, i;
+	for(i = slot; i > 0; i -= i & -i){
+		sum += con->outtree[i - 1];
+	}
+
+	return sum;
+}
+
+// Lines added since the last layout count as one row until they are shown, their slots can still have the rows of evicted lines
+static void _mc_wrap_sync(struct mc_console *con)
+{
+	const struct mc_ring *out = &con->out;
+	unsigned line = con->outindexend;
+	if(out->end - line > MC_MAX_OUTPUT_LINES){
+		line = out->end - MC_MAX_OUTPUT_LINES;
+	}
+
+	for(; line != out->end; line++){
+		unsigned slot = line & (MC_MAX_OUTPUT_LINES - 1);
+		struct _mc_wrap *w = con->outwrap + slot;
+		if(w->line != line){
+			_mc_wrap_add(con, slot, 1 - w->rows);
+			w->line = line;
+			w->len = _MC_NO_LINE;
+			w->rows = 1;
 		}
 	}
+	con->outindexend = out->end;
+}
 
-	if(reminder > 0){
-		unsigned char j;
-		for(j = 0; j < reminder; j++){
-			_mc_default_font_data[i * 8 + j] = (_mc_default_font_bin[i + 13] >> j) & 1;
+// Rows of the line at the width of the grid, its characters are only counted again when it changed
+static unsigned _mc_wrap_rows(struct mc_console *con, unsigned line)
+{
+	const struct mc_ring *out = &con->out;
+	unsigned slot = line & (MC_MAX_OUTPUT_LINES - 1);
+	struct _mc_wrap *w = con->outwrap + slot;
+	unsigned len = _mc_ring_line_len(out, line);
+	if(w->line != line || w->len != len){
+		unsigned pos = _mc_ring_line_start(out, line), end = pos + len;
+		w->line = line;
+		w->len = len;
+		w->chars = 0;
+		while(pos < end){
+			uint32_t cp;
+			pos += _mc_ring_next(out, pos, end, &cp);
+			w->chars++;
 		}
 	}
 
-	_mc_default_font_is_allocated = true;
+	unsigned rows = w->chars == 0 ? 1 : (w->chars + con->outwidth - 1) / con->outwidth;
+	if(rows != w->rows){
+		_mc_wrap_add(con, slot, rows - w->rows);
+		w->rows = rows;
+	}
 
-	return 0;
+	return rows;
 }
 
-MC_API int mc_blit_glyph_default(struct mc_console *con, unsigned x, unsigned y, char glyph)
+// Position of the first character of row sub of the line
+static unsigned _mc_wrap_row_start(struct mc_console *con, unsigned line, unsigned sub)
 {
-	int c = glyph - _mc_default_font_glyph_start;
-	if(c < 0 || c > _mc_default_font_glyph_num){
-		return -2;
+	const struct mc_ring *out = &con->out;
+	const struct _mc_wrap *w = con->outwrap + (line & (MC_MAX_OUTPUT_LINES - 1));
+	unsigned pos = _mc_ring_line_start(out, line), end = pos + w->len;
+	unsigned skip = sub * con->outwidth;
+	if(w->chars == w->len){
+		// Only ASCII, every byte is a character
+		return pos + skip;
+	}
+
+	while(skip > 0 && pos < end){
+		uint32_t cp;
+		pos += _mc_ring_next(out, pos, end, &cp);
+		skip--;
 	}
 
-	int start = c * _mc_default_font_glyph_width;
+	return pos;
+}
 
-	int i;
-	for(i = 0; i < _mc_default_font_glyph_height; i++){
-		int j, ty = (y + i) * con->width;
-		for(j = 0; j < _mc_default_font_glyph_width; j++){
-			unsigned char bit = (_mc_default_font_data[start + j + i * _mc_default_font_width] & 1) * 255;
+// Lines of the output that are shown, the empty line after a trailing newline is not
+static unsigned _mc_wrap_count(const struct mc_console *con)
+{
+	const struct mc_ring *out = &con->out;
+	unsigned count = out->end - out->first;
+	if(_mc_ring_line_len(out, out->end - 1) == 0){
+		count--;
+	}
+	if(count == 1 && _mc_ring_line_len(out, out->first) == 0){
+		count = 0;
+	}
 
-			con->pixels[x + j + ty] = (struct mc_pixel){bit, bit, bit
-#if defined MC_OUTPUT_TEXTURE_RGBA || defined MC_OUTPUT_TEXTURE_BGRA
-				,bit
-#endif
-			};
+	return count;
+}
+
+// Rows of the lines from the first line of the output up to line, lines that weren't shown yet count as one row
+static unsigned _mc_wrap_rows_before(const struct mc_console *con, unsigned line)
+{
+	unsigned n = line - con->out.first, start = con->out.first & (MC_MAX_OUTPUT_LINES - 1);
+	if(start + n <= MC_MAX_OUTPUT_LINES){
+		return n + _mc_wrap_prefix(con, start + n) - _mc_wrap_prefix(con, start);
+	}
+
+	return n + _mc_wrap_prefix(con, MC_MAX_OUTPUT_LINES) - _mc_wrap_prefix(con, start) + _mc_wrap_prefix(con, start + n - MC_MAX_OUTPUT_LINES);
+}
+
+// Find the line with the row counting from the first line of the output, row becomes the row in the line
+static unsigned _mc_wrap_find(const struct mc_console *con, unsigned *row)
+{
+	unsigned start = con->out.first & (MC_MAX_OUTPUT_LINES - 1);
+	// Search from slot 0 with the rows of the slots before the first line, wrapping around after the last slot
+	unsigned target = *row + start + _mc_wrap_prefix(con, start), total = MC_MAX_OUTPUT_LINES + _mc_wrap_prefix(con, MC_MAX_OUTPUT_LINES);
+	if(target >= total){
+		target -= total;
+	}
+
+	unsigned slot = 0, step;
+	for(step = MC_MAX_OUTPUT_LINES; step > 0; step >>= 1){
+		unsigned rows = step + con->outtree[slot + step - 1];
+		if(slot + step <= MC_MAX_OUTPUT_LINES && rows <= target){
+			slot += step;
+			target -= rows;
 		}
 	}
+	*row = target;
 
-	return 0;
+	return con->out.first + ((slot - start) & (MC_MAX_OUTPUT_LINES - 1));
 }
 
+// Move the output rows up, both the presented and the new cells
+static void _mc_grid_scroll(struct mc_console *con, unsigned rows, unsigned lines)
+{
+	unsigned cols = con->outwidth;
+	con->outshifted += lines;
+	memmove(con->cells, con->cells + lines * cols, (rows - lines) * cols * sizeof(struct mc_cell));
+	memmove(con->prevcells, con->prevcells + lines * cols, (rows - lines) * cols * sizeof(struct mc_cell));
+
+	unsigned i;
+	for(i = (rows - lines) * cols; i < rows * cols; i++){
+		con->prevcells[i] = _MC_NO_CELL;
+	}
+
 #ifdef MC_OUTPUT_TEXTURE
-MC_API int mc_set_texture_size(struct mc_console *con, unsigned width, unsigned height)
+	if(con->pixels){
+		unsigned gh = con->font->glyphheight;
+		memmove(con->pixels, con->pixels + lines * gh * con->width, (rows - lines) * gh * con->width * sizeof(struct mc_pixel));
+		mc_damage(con, 0, 0, cols * con->font->glyphwidth, (rows - lines) * gh);
+	}
+#endif
+}
+
+// Top of the view when it follows the end of the output, returns the number of rows with output
+static unsigned _mc_wrap_bottom(struct mc_console *con, unsigned end, unsigned *topline, unsigned *toprow)
+{
+	unsigned rows = con->outheight - 1, shown = 0;
+	*topline = end;
+	while(*topline != con->out.first && shown < rows){
+		(*topline)--;
+		shown += _mc_wrap_rows(con, *topline);
+	}
+	*toprow = shown > rows ? shown - rows : 0;
+
+	return shown < rows ? shown : rows;
+}
+
+// Put the top of the view at the last page of the output when it's scrolled past it, returns true when it's following the end
+static bool _mc_wrap_clamp(struct mc_console *con, unsigned count)
+{
+	if(!con->outscrolled){
+		return true;
+	}
+
+	unsigned rows = con->outheight - 1, first = con->out.first;
+	if(con->outtopline - first >= count){
+		// The line was dropped from the scrollback
+		con->outtopline = first;
+		con->outtoprow = 0;
+	}
+
+	// Only the rows up to a screen full below the top are counted
+	unsigned line = con->outtopline, below = 0;
+	for(; line - first < count && below < con->outtoprow + rows; line++){
+		below += _mc_wrap_rows(con, line);
+	}
+	if(below < con->outtoprow + rows){
+		con->outscrolled = false;
+		return true;
+	}
+
+	return false;
+}
+
+// Lay out the output above the input line, the last lines when following it and otherwise from the scrolled to row.
+// Returns the first row that has to be compared.
+static unsigned _mc_layout_output(struct mc_console *con)
+{
+	unsigned rows = con->outheight - 1, cols = con->outwidth;
+	const struct mc_ring *out = &con->out;
+
+	_mc_wrap_sync(con);
+	_mc_span_trim(con);
+	unsigned count = _mc_wrap_count(con);
+	unsigned end = out->first + count;
+
+	unsigned top = 0, topline = con->outtopline, toprow = con->outtoprow, first = 0;
+	bool following = _mc_wrap_clamp(con, count);
+	if(following){
+		top = rows - _mc_wrap_bottom(con, end, &topline, &toprow);
+
+		// Output is only appended, so only the previously last row can have changed and the rows above it moved up
+		if(con->outlaidline != _MC_NO_LINE && con->outlaidline - out->first < count){
+			unsigned lines = _mc_wrap_rows(con, con->outlaidline) - con->outlaidrows, line;
+			for(line = con->outlaidline + 1; line != end && lines < rows; line++){
+				lines += _mc_wrap_rows(con, line);
+			}
+			if(lines < rows){
+				first = rows - 1 - lines;
+				if(lines > 0){
+					_mc_grid_scroll(con, rows, lines);
+				}
+
+				// Lines that were dropped from the scrollback moved into what should be blank rows at the top
+				unsigned blank = con->outlaidtop > lines ? con->outlaidtop - lines : 0;
+				if(blank < top && blank < first){
+					first = blank;
+				}
+			}
+		}
+	}
+
+	unsigned row;
+	for(row = first; row < top; row++){
+		_mc_layout_blank(con->cells + row * cols, cols);
+	}
+	if(row < rows){
+		// Find the line on the first row that's laid out
+		unsigned line = topline, sub = toprow + (row - top);
+		unsigned linerows = _mc_wrap_rows(con, line);
+		while(sub >= linerows){
+			sub -= linerows;
+			linerows = _mc_wrap_rows(con, ++line);
+		}
+
+		unsigned pos = _mc_wrap_row_start(con, line, sub), lineend = _mc_ring_line_start(out, line) + _mc_ring_line_len(out, line);
+		unsigned span = _mc_span_find(con, pos);
+		for(; row < rows; row++){
+			if(sub == linerows){
+				line++;
+				sub = 0;
+				linerows = _mc_wrap_rows(con, line);
+				pos = _mc_ring_line_start(out, line);
+				lineend = pos + _mc_ring_line_len(out, line);
+			}
+			pos = _mc_layout_row(con->cells + row * cols, cols, con, pos, lineend, &span);
+			sub++;
+		}
+	}
+
+	if(following && count > 0){
+		con->outlaidline = end - 1;
+		con->outlaidrows = _mc_wrap_rows(con, end - 1);
+	}else{
+		con->outlaidline = _MC_NO_LINE;
+	}
+	con->outlaidtop = top;
+
+	return first;
+}
+
+MC_API int mc_output_position(struct mc_console *con, unsigned *top, unsigned *total)
 {
 	MC_ASSERT(con);
 
-	if(con->pixels){
-		con->pixels = (struct mc_pixel*)realloc(con->pixels, width * height * sizeof(struct mc_pixel));
+	if(!con->cells || con->outheight < 2){
+		return -1;
+	}
+
+	_mc_wrap_sync(con);
+	unsigned end = con->out.first + _mc_wrap_count(con), topline = con->outtopline, toprow = con->outtoprow;
+	if(_mc_wrap_clamp(con, end - con->out.first)){
+		_mc_wrap_bottom(con, end, &topline, &toprow);
+	}
+	if(top){
+		*top = _mc_wrap_rows_before(con, topline) + toprow;
+	}
+	if(total){
+		*total = _mc_wrap_rows_before(con, end);
+	}
+
+	return 0;
+}
+
+MC_API int mc_output_seek(struct mc_console *con, unsigned row)
+{
+	unsigned total;
+	if(mc_output_position(con, NULL, &total)){
+		return -1;
+	}
+
+	con->outdirty = true;
+	con->outlaidline = _MC_NO_LINE;
+	con->outscrolled = row + con->outheight - 1 < total;
+	if(con->outscrolled){
+		con->outtopline = _mc_wrap_find(con, &row);
+		con->outtoprow = row;
+	}
+
+	return 0;
+}
+
+MC_API int mc_output_scroll(struct mc_console *con, int rows)
+{
+	unsigned top;
+	if(mc_output_position(con, &top, NULL)){
+		return -1;
+	}
+
+	unsigned n = rows < 0 ? -(unsigned)rows : (unsigned)rows;
+	if(n > 4 * con->outheight){
+		// Far jumps go through the index, the rows of the lines in between don't have to be known
+		return mc_output_seek(con, rows > 0 ? (n < top ? top - n : 0) : top + n);
+	}
+
+	// Near scrolling counts the rows on the way so it moves exactly that many
+	unsigned first = con->out.first, count = _mc_wrap_count(con);
+	unsigned topline = con->outtopline, toprow = con->outtoprow;
+	if(!con->outscrolled){
+		_mc_wrap_bottom(con, first + count, &topline, &toprow);
+	}
+	if(rows > 0){
+		while(n > 0){
+			if(toprow > 0){
+				unsigned step = toprow < n ? toprow : n;
+				toprow -= step;
+				n -= step;
+			}else if(topline != first){
+				topline--;
+				toprow = _mc_wrap_rows(con, topline) - 1;
+				n--;
+			}else{
+				break;
+			}
+		}
 	}else{
-		con->pixels = (struct mc_pixel*)malloc(width * height * sizeof(struct mc_pixel));
-		_mc_font_allocate();
+		while(n > 0 && topline - first < count){
+			unsigned linerows = _mc_wrap_rows(con, topline);
+			if(toprow + n < linerows){
+				toprow += n;
+				break;
+			}
+			n -= linerows - toprow;
+			topline++;
+			toprow = 0;
+		}
 	}
 
-	con->width = width;
-	con->height = height;
+	con->outdirty = true;
+	con->outlaidline = _MC_NO_LINE;
+	con->outscrolled = true;
+	con->outtopline = topline;
+	con->outtoprow = toprow;
+	_mc_wrap_clamp(con, count);
 
 	return 0;
 }
-#endif // MC_OUTPUT_TEXTURE
 
+// While searching the prompt shows the query
+static const char *_mc_prompt_head(const struct mc_console *con)
+{
+	return con->search[con->searchlen].found ? "(search)'" : "(failed search)'";
+}
+
+// Shown in front of the prompt while async commands are running
+#define _MC_BUSY_PROMPT "[running] "
+
+static unsigned _mc_prompt_busy(const struct mc_console *con)
+{
+#ifdef MC_MULTITHREADED
+	if(con->njobs > 0){
+		return sizeof(_MC_BUSY_PROMPT) - 1;
+	}
+#endif
+
+	return 0;
+}
+
+// The parts of the prompt, looked up once for every layout of the input row
+struct _mc_prompt {
+	const char *head;
+	unsigned busy, headlen, len;
+};
+
+static void _mc_prompt_get(const struct mc_console *con, struct _mc_prompt *prompt)
+{
+	prompt->busy = _mc_prompt_busy(con);
+	prompt->head = con->searching ? _mc_prompt_head(con) : MC_PROMPT;
+	prompt->headlen = strlen(prompt->head);
+	prompt->len = prompt->busy + prompt->headlen;
+	if(con->searching){
+		prompt->len += con->searchlen + 3;
+	}
+}
+
+static char _mc_prompt_at(const struct mc_console *con, const struct _mc_prompt *prompt, unsigned pos)
+{
+	if(pos < prompt->busy){
+		return _MC_BUSY_PROMPT[pos];
+	}
+	pos -= prompt->busy;
+	if(pos < prompt->headlen){
+		return prompt->head[pos];
+	}
+	pos -= prompt->headlen;
+	if(pos < con->searchlen){
+		return con->search[pos + 1].c;
+	}
+
+	return "': "[pos - con->searchlen];
+}
+
+// Byte pos of the prompt followed by the input text
+static char _mc_line_at(const struct mc_console *con, const struct _mc_prompt *prompt, unsigned pos)
+{
+	return pos < prompt->len ? _mc_prompt_at(con, prompt, pos) : _mc_input_at(con, pos - prompt->len);
+}
+
+static void _mc_layout_input(struct mc_console *con)
+{
+	unsigned cols = con->outwidth;
+	struct mc_cell *cells = con->cells + (con->outheight - 1) * cols;
+	struct _mc_prompt prompt;
+	_mc_prompt_get(con, &prompt);
+	unsigned end = prompt.len + _mc_input_len(con);
+
+	// Every character is a column, scroll horizontally so the cursor is always visible
+	unsigned cursor = 0, pos;
+	for(pos = 0; pos < prompt.len + con->inpos; pos++){
+		if(!_MC_UTF8_CONT(_mc_line_at(con, &prompt, pos))){
+			cursor++;
+		}
+	}
+	unsigned scroll = cursor >= cols ? cursor - cols + 1 : 0;
+
+	unsigned col;
+	pos = 0;
+	for(col = 0; col < scroll + cols; col++){
+		uint32_t cp = ' ';
+		if(pos < end){
+			char b[4];
+			unsigned n;
+			for(n = 0; n < 4 && pos + n < end; n++){
+				b[n] = _mc_line_at(con, &prompt, pos + n);
+			}
+			pos += _mc_utf8_next(b, n, &cp);
+		}
+		if(col >= scroll){
+			cells[col - scroll] = (struct mc_cell){cp, col == cursor ? MC_ATTR_INVERSE : 0, MC_DEFAULT_FG, MC_DEFAULT_BG};
+		}
+	}
+}
+
+MC_API int mc_render(struct mc_console *con)
+{
+	MC_ASSERT(con);
+
+	if(!con->cells){
+		return -1;
+	}
 
+	unsigned cols = con->outwidth, rows = con->outheight;
+	unsigned first = rows, last = rows;
+	if(con->outdirty && rows > 1){
+		first = _mc_layout_output(con);
+		last = rows - 1;
+		con->outdirty = false;
+	}
+	if(con->indirty){
+		_mc_layout_input(con);
+		if(first == rows){
+			first = rows - 1;
+		}
+		last = rows;
+		con->indirty = false;
+	}
+
+#if defined MC_MULTITHREADED && defined MC_OUTPUT_TEXTURE
+	// A single row isn't worth waking up the render threads for
+	if(con->pixels && con->nrenderthreads > 1 && first + 1 < last){
+		return _mc_render_parallel(con, first, last);
+	}
+#endif
+
+	// Only the rows that were laid out again can differ from what is presented
+	unsigned y;
+	for(y = first; y < last; y++){
+		unsigned x;
+		for(x = 0; x < cols; x++){
+			struct mc_cell cell = con->cells[x + y * cols];
+			struct mc_cell *prev = con->prevcells + x + y * cols;
+			if(_mc_cell_equal(cell, *prev)){
+				continue;
+			}
+#ifdef MC_OUTPUT_TEXTURE
+			if(con->pixels){
+				_mc_present_cell(con, x, y, cell);
+			}
+#endif
+			*prev = cell;
+		}
+	}
+
+	return 0;
+}
 
 #endif // MC_IMPLEMENTATION
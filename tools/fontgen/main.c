@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Expands a ccFont file to the layout mc_font uses at runtime
+ * and prints it as C, see the Makefile. */
+#define MC_IMPLEMENTATION
+#define MC_OUTPUT_TEXTURE_RGBA
+#include "../../micronsole.h"
+
+// Values printed per line
+#define PER_LINE 8
+
+static unsigned char *read_file(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if(!f){
+		return NULL;
+	}
+
+	size_t cap = 4096, len = 0, n;
+	unsigned char *data = (unsigned char*)malloc(cap);
+	while(data && (n = fread(data + len, 1, cap - len, f)) > 0){
+		len += n;
+		if(len == cap){
+			cap *= 2;
+			unsigned char *grown = (unsigned char*)realloc(data, cap);
+			if(!grown){
+				free(data);
+			}
+			data = grown;
+		}
+	}
+	fclose(f);
+
+	*size = len;
+	return data;
+}
+
+static void print_array(const char *type, const char *name, const char *suffix, const char *format, const long *values, unsigned num)
+{
+	printf("static const %s %s_%s[%u] = {", type, name, suffix, num);
+	unsigned i;
+	for(i = 0; i < num; i++){
+		printf(i % PER_LINE == 0 ? "\n\t" : " ");
+		printf(format, values[i]);
+		printf(i + 1 < num ? "," : "\n");
+	}
+	printf("};\n");
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 3){
+		fprintf(stderr, "Usage: %s FONT.ccf NAME\n", argv[0]);
+		return 1;
+	}
+
+	size_t size;
+	unsigned char *data = read_file(argv[1], &size);
+	if(!data){
+		fprintf(stderr, "Can't read \"%s\"\n", argv[1]);
+		return 1;
+	}
+	struct mc_font *font = mc_font_load(data, size);
+	free(data);
+	if(!font){
+		fprintf(stderr, "\"%s\" is not a valid ccFont file\n", argv[1]);
+		return 1;
+	}
+
+	const char *name = argv[2];
+	unsigned nrows = font->nglyphs * font->glyphheight, npages = 0, i;
+	for(i = 0; i < font->npagemap; i++){
+		if(font->pagemap[i] + 1u > npages){
+			npages = font->pagemap[i] + 1;
+		}
+	}
+
+	unsigned num = nrows > npages * 256 ? nrows : npages * 256;
+	long *values = (long*)malloc(num * sizeof(long));
+	if(!values){
+		return 1;
+	}
+
+	printf("// Generated by tools/fontgen from %s, don't edit\n", argv[1]);
+	for(i = 0; i < nrows; i++){
+		values[i] = font->rows[i];
+	}
+	print_array("uint32_t", name, "rows", "0x%lx", values, nrows);
+	for(i = 0; i < font->npagemap; i++){
+		values[i] = font->pagemap[i];
+	}
+	print_array("uint16_t", name, "pagemap", "%ld", values, font->npagemap);
+	for(i = 0; i < npages * 256; i++){
+		values[i] = font->pages[i];
+	}
+	print_array("int16_t", name, "pages", "%ld", values, npages * 256);
+	printf("static struct mc_font %s = {\n", name);
+	printf("\t-1, %u, %u, %u, %s_rows, %s_pagemap, %s_pages, %u, %d\n", font->glyphwidth, font->glyphheight, font->nglyphs,
+			name, name, name, font->npagemap, font->replacement);
+	printf("};\n");
+
+	free(values);
+	mc_font_release(font);
+
+	return 0;
+}